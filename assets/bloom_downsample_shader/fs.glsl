@@ -0,0 +1,24 @@
+#version 330 core
+
+in vec2 TexCoords;
+uniform sampler2D ION_PASS_IN;
+uniform vec2 ION_UV_SCALE = vec2(1.0);
+out vec4 FragColor;
+
+// Keeps bilinear taps inside the drawn area of the source, whose texels
+// outside it are stale.
+vec3 Tap(vec2 uv, vec2 half_pixel) {
+  return texture(ION_PASS_IN, clamp(uv, half_pixel, ION_UV_SCALE - half_pixel)).rgb;
+}
+
+// Dual filter downsample: the center and four diagonal taps half a source
+// texel away, each a bilinear average of four texels.
+void main() {
+  vec2 half_pixel = 0.5 / vec2(textureSize(ION_PASS_IN, 0));
+  vec3 result = Tap(TexCoords, half_pixel) * 4.0;
+  result += Tap(TexCoords - half_pixel, half_pixel);
+  result += Tap(TexCoords + half_pixel, half_pixel);
+  result += Tap(TexCoords + vec2(half_pixel.x, -half_pixel.y), half_pixel);
+  result += Tap(TexCoords - vec2(half_pixel.x, -half_pixel.y), half_pixel);
+  FragColor = vec4(result / 8.0, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+
+in vec2 TexCoords;
+uniform sampler2D ION_PASS_IN;
+uniform vec2 ION_UV_SCALE = vec2(1.0);
+out vec4 FragColor;
+
+// Keeps bilinear taps inside the drawn area of the source, whose texels
+// outside it are stale.
+vec3 Tap(vec2 uv, vec2 half_pixel) {
+  return texture(ION_PASS_IN, clamp(uv, half_pixel, ION_UV_SCALE - half_pixel)).rgb;
+}
+
+// Dual filter upsample: a tent of eight taps around the source texel.
+void main() {
+  vec2 half_pixel = 0.5 / vec2(textureSize(ION_PASS_IN, 0));
+  vec3 result = Tap(TexCoords + vec2(-half_pixel.x * 2.0, 0.0), half_pixel);
+  result += Tap(TexCoords + vec2(-half_pixel.x, half_pixel.y), half_pixel) * 2.0;
+  result += Tap(TexCoords + vec2(0.0, half_pixel.y * 2.0), half_pixel);
+  result += Tap(TexCoords + vec2(half_pixel.x, half_pixel.y), half_pixel) * 2.0;
+  result += Tap(TexCoords + vec2(half_pixel.x * 2.0, 0.0), half_pixel);
+  result += Tap(TexCoords + vec2(half_pixel.x, -half_pixel.y), half_pixel) * 2.0;
+  result += Tap(TexCoords + vec2(0.0, -half_pixel.y * 2.0), half_pixel);
+  result += Tap(TexCoords + vec2(-half_pixel.x, -half_pixel.y), half_pixel) * 2.0;
+  FragColor = vec4(result / 12.0, 1.0);
+}
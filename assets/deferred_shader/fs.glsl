@@ -9,42 +9,73 @@ struct Light {
   vec3 color;
 };
 
-const int MAX_LIGHTS = 32;
-
 in vec2 TexCoord;
 out vec4 FragColor;
 
 uniform sampler2D color_texture;
 uniform sampler2D normal_texture;
-uniform int light_count;
-uniform Light lights[MAX_LIGHTS];
+// Corner of the drawn area of the G-buffer.
+uniform vec2 ION_UV_SCALE = vec2(1.0);
+// Three texels per light, global lights first:
+// (type, position.x, position.y, intensity),
+// (color.rgb, radial_falloff), (volumetric_intensity, 0, 0, 0).
+uniform samplerBuffer light_data;
+// (first index, count) into light_indices for each screen tile.
+uniform usamplerBuffer light_tiles;
+uniform usamplerBuffer light_indices;
+uniform int global_light_count;
+uniform int light_tile_size;
+uniform int light_tiles_x;
+
+Light FetchLight(int index) {
+  vec4 a = texelFetch(light_data, index * 3);
+  vec4 b = texelFetch(light_data, index * 3 + 1);
+  vec4 c = texelFetch(light_data, index * 3 + 2);
+  Light light;
+  light.type = int(a.x);
+  light.position = a.yz;
+  light.intensity = a.w;
+  light.color = b.rgb;
+  light.radial_falloff = b.a;
+  light.volumetric_intensity = c.x;
+  return light;
+}
+
+vec3 Shade(Light light, vec3 albedo, vec3 normal) {
+  if (light.type == 0) {
+    return albedo * light.color * light.intensity;
+  }
+  vec2 light_offset = light.position - TexCoord;
+  vec3 light_dir = normalize(vec3(light_offset, 0.0));
+  float distance = length(light_offset);
+  float attenuation = light.intensity / (1.0 + light.radial_falloff * distance * distance);
+  attenuation = max(attenuation, 0.0);
+  float diff = max(dot(normal, light_dir), 0.0);
+  vec3 lighting = albedo * light.color * diff * attenuation;
+  float volumetric = light.volumetric_intensity / (1.0 + distance * distance);
+  return lighting + light.color * volumetric * attenuation;
+}
 
 void main() {
-  vec4 sample = texture(color_texture, TexCoord);
+  vec2 uv = TexCoord * ION_UV_SCALE;
+  vec4 sample = texture(color_texture, uv);
   if (sample.a == 0.0) {
     discard;
   }
   vec3 albedo = sample.rgb;
-  vec3 normal = texture(normal_texture, TexCoord).rgb * 2.0 - 1.0;
+  vec3 normal = texture(normal_texture, uv).rgb * 2.0 - 1.0;
   normal = normalize(normal);
   
   vec3 total_lighting = vec3(0.0);
-  for (int i = 0; i < light_count && i < MAX_LIGHTS; i++) {
-    if (lights[i].type == 0) {
-      total_lighting += albedo * lights[i].color * lights[i].intensity;
-    }
-    else if (lights[i].type == 1) {
-      vec2 light_offset = lights[i].position - TexCoord;
-      vec3 light_dir = normalize(vec3(light_offset, 0.0));
-      float distance = length(light_offset);
-      float attenuation = lights[i].intensity / (1.0 + lights[i].radial_falloff * distance * distance);
-      attenuation = max(attenuation, 0.0);
-      float diff = max(dot(normal, light_dir), 0.0);
-      total_lighting += albedo * lights[i].color * diff * attenuation;
-      float volumetric = lights[i].volumetric_intensity / (1.0 + distance * distance);
-      total_lighting += lights[i].color * volumetric * attenuation;
-    }
+  for (int i = 0; i < global_light_count; i++) {
+    total_lighting += Shade(FetchLight(i), albedo, normal);
+  }
+  ivec2 tile = ivec2(gl_FragCoord.xy) / light_tile_size;
+  uvec2 range = texelFetch(light_tiles, tile.y * light_tiles_x + tile.x).xy;
+  for (uint i = 0u; i < range.y; i++) {
+    int index = int(texelFetch(light_indices, int(range.x + i)).x);
+    total_lighting += Shade(FetchLight(index), albedo, normal);
   }
   
   FragColor = vec4(total_lighting, 1.0);
-}
\ No newline at end of file
+}
@@ -4,7 +4,10 @@ layout (location = 1) in vec2 aTexCoord;
 
 out vec2 TexCoord;
 
+// Corner of the drawn area of the sampled target.
+uniform vec2 ION_UV_SCALE = vec2(1.0);
+
 void main() {
-  TexCoord = aTexCoord;
+  TexCoord = aTexCoord * ION_UV_SCALE;
   gl_Position = vec4(aPos, 0.0, 1.0);
 }
\ No newline at end of file
@@ -1,9 +1,11 @@
 #version 330 core
 
 in vec2 TexCoord;
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 FragNormal;
 
 uniform sampler2D sample;
+uniform sampler2D normal_sample;
 
 void main() {
   vec4 sampled = texture(sample, TexCoord);
@@ -11,4 +13,5 @@ void main() {
     discard;
   }
   FragColor = sampled;
+  FragNormal = texture(normal_sample, TexCoord);
 }
@@ -7,9 +7,11 @@ out vec2 TexCoord;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+// Area of the sprite within its texture: (offset, size).
+uniform vec4 uv_rect = vec4(0.0, 0.0, 1.0, 1.0);
 
 void main()
 {
-    TexCoord = aTexCoord;
+    TexCoord = uv_rect.xy + aTexCoord * uv_rect.zw;
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+// Per-instance model: the scaled x and y axes, then translation and layer.
+layout (location = 2) in vec4 aBasis;
+layout (location = 3) in vec4 aTranslation;
+// Per-instance area of the sprite within its texture: (offset, size).
+layout (location = 4) in vec4 aUVRect;
+
+out vec2 TexCoord;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    mat4 model = mat4(vec4(aBasis.xy, 0.0, 0.0),
+                      vec4(aBasis.zw, 0.0, 0.0),
+                      vec4(0.0, 0.0, 1.0, 0.0),
+                      vec4(aTranslation.xyz, 1.0));
+    TexCoord = aUVRect.xy + aTexCoord * aUVRect.zw;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
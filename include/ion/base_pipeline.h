@@ -1,34 +1,61 @@
 #pragma once
+#include "ion/frame_packet.h"
+#include "ion/render_graph.h"
+#include <functional>
 #include <memory>
+#include <vector>
 struct Framebuffer;
 struct Shader;
 struct GPUData;
 struct World;
 
+// Depth of the bloom mip chain; each level halves the resolution.
+constexpr int BLOOM_LEVELS = 6;
+
 struct PipelineSettings {
   bool bloom_enable = true;
+  // Bloom radius. The chain runs ceil(log2(strength)) + 1 levels deep, so the
+  // radius, which doubles per level, grows in proportion to the strength.
   int bloom_strength = 10;
   bool render_to_output_buffer = false;
 };
 
+// Adds passes that process the lit scene and returns the resource holding
+// the result, or scene itself to leave it unchanged. Runs after lighting and
+// before bloom.
+using CustomPass =
+    std::function<RenderResource(RenderGraph &graph, RenderResource scene)>;
+
 struct BasePipeline {
-  std::shared_ptr<Framebuffer> color_buffer;
-  std::shared_ptr<Framebuffer> normal_buffer;
-  std::shared_ptr<Framebuffer> shaded;
-  std::shared_ptr<Framebuffer> bloom_buffer;
-  std::shared_ptr<Framebuffer> bloom_buffer_2;
+  // Rebuilt every frame. G-buffer, lighting and bloom targets are transients
+  // of the graph, so disabled stages cost no memory.
+  RenderGraph graph;
+  std::vector<CustomPass> custom_passes;
 
+  // Created on first use by render_to_output_buffer.
 	std::shared_ptr<Framebuffer> output_buffer;
 
   std::shared_ptr<Shader> deferred_shader;
   std::shared_ptr<Shader> screen_shader;
   std::shared_ptr<Shader> bloom_shader;
-  std::shared_ptr<Shader> bloom_blur_shader;
+  std::shared_ptr<Shader> bloom_downsample_shader;
+  std::shared_ptr<Shader> bloom_upsample_shader;
   std::shared_ptr<Shader> combine_shader;
   std::shared_ptr<Shader> tonemap_shader;
 
   std::shared_ptr<GPUData> screen_data;
 
+  // Packets handed from simulation to rendering.
+  FrameSnapshots snapshots;
+
+  // Extracts a packet from the world, publishes it and draws it.
   void Render(std::shared_ptr<World> world, const PipelineSettings &settings);
+  // Draws a published packet. Touches no World state, so it can run while
+  // the next tick is simulated.
+  void Render(const FramePacket &packet, const PipelineSettings &settings);
   BasePipeline();
+
+private:
+  RenderResource AddBloomPasses(RenderResource scene,
+                                const PipelineSettings &settings);
 };
\ No newline at end of file
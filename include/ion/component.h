@@ -1,4 +1,5 @@
 #pragma once
+#include "component_set.h"
 #include "exports.h"
 #include <box2d/box2d.h>
 #include <glm/glm.hpp>
@@ -18,6 +19,13 @@ struct ION_API Transform {
   float rotation = 0.0f;
 };
 
+// Parents an entity to another. The entity's Transform is then relative to
+// the parent's world transform. Change the parent through World::SetParent
+// or World::Patch so the change is tracked.
+struct ION_API Hierarchy {
+  EntityID parent = NULL_ENTITY;
+};
+
 struct ION_API PhysicsBody {
   b2BodyId body_id{};
   bool enabled = false;
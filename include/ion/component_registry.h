@@ -0,0 +1,38 @@
+#pragma once
+#include "component_set.h"
+#include "exports.h"
+#include <cstddef>
+#include <cstdint>
+#include <typeindex>
+#include <typeinfo>
+
+using ComponentTypeID = std::uint32_t;
+
+namespace ion::internal {
+// IDs are handed out by ion-base so every module agrees on them.
+ION_API ComponentTypeID RegisterComponentType(std::type_index type);
+} // namespace ion::internal
+
+// Dense ID of a component type, assigned on first use and cached per module.
+template <typename T> ComponentTypeID GetComponentTypeID() {
+  static const auto id = ion::internal::RegisterComponentType(typeid(T));
+  return id;
+}
+
+// Type-erased access to a component pool, for operations World applies to
+// every pool without knowing its type.
+class ComponentPool {
+public:
+  virtual ~ComponentPool() = default;
+  virtual void Remove(EntityID entity) = 0;
+  virtual void SetTick(std::uint32_t tick) = 0;
+  virtual std::size_t Size() const = 0;
+};
+
+template <typename T> class TypedComponentPool final : public ComponentPool {
+public:
+  ComponentSet<T> set;
+  void Remove(EntityID entity) override { set.Remove(entity); }
+  void SetTick(std::uint32_t tick) override { set.SetTick(tick); }
+  std::size_t Size() const override { return set.Size(); }
+};
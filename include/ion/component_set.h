@@ -0,0 +1,225 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Entity handles pack a slot index (low bits) and a generation (high bits).
+// The generation is bumped whenever a slot is recycled, so handles to
+// destroyed entities never alias the entity that reuses their slot.
+using EntityID = std::uint32_t;
+const EntityID NULL_ENTITY = std::numeric_limits<EntityID>::max();
+constexpr std::uint32_t ENTITY_INDEX_BITS = 20;
+constexpr std::uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+constexpr std::uint32_t ENTITY_GENERATION_MASK =
+    (1u << (32 - ENTITY_INDEX_BITS)) - 1;
+
+constexpr std::uint32_t GetEntityIndex(EntityID entity) {
+  return entity & ENTITY_INDEX_MASK;
+}
+constexpr std::uint32_t GetEntityGeneration(EntityID entity) {
+  return entity >> ENTITY_INDEX_BITS;
+}
+constexpr EntityID MakeEntityID(std::uint32_t index, std::uint32_t generation) {
+  return ((generation & ENTITY_GENERATION_MASK) << ENTITY_INDEX_BITS) |
+         (index & ENTITY_INDEX_MASK);
+}
+
+// Sparse-set storage for one component type. Components are packed by value
+// in a dense array, with a paged sparse array mapping entity indices to their
+// dense slot. Lookups, insertion and removal are O(1); iteration walks the
+// dense arrays front to back. Lookups compare the full handle, so a stale
+// handle (older generation) finds nothing.
+// Each component carries the world tick it was last changed at. Insertion
+// stamps it; in-place edits must be reported with MarkChanged (or go through
+// World::Patch) to be seen by ChangedSince queries.
+// Note: Pointers returned by Emplace/Get are invalidated by any insertion or
+// removal on the same set. Do not hold them across structural changes.
+template <typename T> class ComponentSet {
+public:
+  static constexpr std::size_t PAGE_SIZE = 4096;
+  static constexpr std::uint32_t NULL_INDEX =
+      std::numeric_limits<std::uint32_t>::max();
+
+  template <bool IsConst> class Iterator {
+    using Set = std::conditional_t<IsConst, const ComponentSet, ComponentSet>;
+    using Ref = std::conditional_t<IsConst, const T &, T &>;
+    Set *set = nullptr;
+    std::size_t index = 0;
+
+  public:
+    Iterator() = default;
+    Iterator(Set *owner, std::size_t position) : set(owner), index(position) {}
+    std::pair<EntityID, Ref> operator*() const {
+      return {set->dense[index], set->components[index]};
+    }
+    Iterator &operator++() {
+      ++index;
+      return *this;
+    }
+    Iterator operator++(int) {
+      auto copy = *this;
+      ++index;
+      return copy;
+    }
+    bool operator==(const Iterator &other) const {
+      return index == other.index;
+    }
+  };
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  // Adds a component for the entity and returns it. If the entity already has
+  // one, the existing component is returned unchanged. Returns nullptr if the
+  // slot holds a component of another generation, so a stale handle never
+  // overwrites the component of the entity that reused its slot.
+  T *Emplace(EntityID entity, T value = T{}) {
+    auto &slot = SparseSlot(entity);
+    if (slot != NULL_INDEX) {
+      return dense[slot] == entity ? &components[slot] : nullptr;
+    }
+    slot = static_cast<std::uint32_t>(dense.size());
+    dense.push_back(entity);
+    components.push_back(std::move(value));
+    versions.push_back(tick);
+    structure_version = tick;
+    return &components.back();
+  }
+
+  T *Get(EntityID entity) {
+    auto index = Find(entity);
+    return index == NULL_INDEX ? nullptr : &components[index];
+  }
+  const T *Get(EntityID entity) const {
+    auto index = Find(entity);
+    return index == NULL_INDEX ? nullptr : &components[index];
+  }
+  bool Contains(EntityID entity) const { return Find(entity) != NULL_INDEX; }
+  // Dense slot of the entity's component, or NULL_INDEX.
+  std::uint32_t IndexOf(EntityID entity) const { return Find(entity); }
+
+  // Appends a copy of value for each entity in [first, first + count). The
+  // entities must not own this component yet.
+  void EmplaceRange(EntityID first, std::uint32_t count, const T &value) {
+    auto offset = dense.size();
+    dense.resize(offset + count);
+    for (std::uint32_t i = 0; i < count; i++) {
+      SparseSlot(first + i) = static_cast<std::uint32_t>(offset + i);
+      dense[offset + i] = first + i;
+    }
+    components.insert(components.end(), count, value);
+    versions.insert(versions.end(), count, tick);
+    structure_version = tick;
+  }
+
+  // Swap-and-pop removal; the last component moves into the freed slot.
+  void Remove(EntityID entity) {
+    auto index = Find(entity);
+    if (index == NULL_INDEX) {
+      return;
+    }
+    auto last = dense.back();
+    if (index != dense.size() - 1) {
+      dense[index] = last;
+      components[index] = std::move(components.back());
+      versions[index] = versions.back();
+      SparseSlot(last) = index;
+    }
+    SparseSlot(entity) = NULL_INDEX;
+    dense.pop_back();
+    components.pop_back();
+    versions.pop_back();
+    structure_version = tick;
+  }
+
+  void Clear() {
+    sparse.clear();
+    dense.clear();
+    components.clear();
+    versions.clear();
+    structure_version = tick;
+  }
+  void Reserve(std::size_t count) {
+    dense.reserve(count);
+    components.reserve(count);
+    versions.reserve(count);
+  }
+
+  // Change tracking. The owning World advances the tick; stamps made during
+  // tick N compare greater than any tick before N.
+  void SetTick(std::uint32_t value) { tick = value; }
+  std::uint32_t GetTick() const { return tick; }
+  // Stamps the entity's component as changed at the current tick.
+  void MarkChanged(EntityID entity) {
+    auto index = Find(entity);
+    if (index != NULL_INDEX) {
+      versions[index] = tick;
+      edit_version = tick;
+    }
+  }
+  // Tick the entity's component was last inserted or changed at, 0 if absent.
+  std::uint32_t VersionOf(EntityID entity) const {
+    auto index = Find(entity);
+    return index == NULL_INDEX ? 0 : versions[index];
+  }
+  bool ChangedSince(EntityID entity, std::uint32_t since) const {
+    return VersionOf(entity) > since;
+  }
+  // Last tick at which a component was added or removed. Dense indices are
+  // only stable across ticks where this did not move.
+  std::uint32_t StructureVersion() const { return structure_version; }
+  // Last tick at which a component was added, removed or marked changed.
+  std::uint32_t LastChange() const {
+    return std::max(structure_version, edit_version);
+  }
+  std::size_t Size() const { return dense.size(); }
+  bool Empty() const { return dense.empty(); }
+
+  // Dense arrays, index-aligned: Entities()[i] owns Components()[i].
+  const std::vector<EntityID> &Entities() const { return dense; }
+  std::vector<T> &Components() { return components; }
+  const std::vector<T> &Components() const { return components; }
+  const std::vector<std::uint32_t> &Versions() const { return versions; }
+
+  iterator begin() { return {this, 0}; }
+  iterator end() { return {this, dense.size()}; }
+  const_iterator begin() const { return {this, 0}; }
+  const_iterator end() const { return {this, dense.size()}; }
+
+private:
+  std::vector<std::unique_ptr<std::uint32_t[]>> sparse;
+  std::vector<EntityID> dense;
+  std::vector<T> components;
+  std::vector<std::uint32_t> versions;
+  std::uint32_t tick = 1;
+  std::uint32_t structure_version = 0;
+  std::uint32_t edit_version = 0;
+
+  std::uint32_t Find(EntityID entity) const {
+    auto page = GetEntityIndex(entity) / PAGE_SIZE;
+    if (page >= sparse.size() || !sparse[page]) {
+      return NULL_INDEX;
+    }
+    auto index = sparse[page][GetEntityIndex(entity) % PAGE_SIZE];
+    if (index == NULL_INDEX || dense[index] != entity) {
+      return NULL_INDEX;
+    }
+    return index;
+  }
+
+  std::uint32_t &SparseSlot(EntityID entity) {
+    auto page = GetEntityIndex(entity) / PAGE_SIZE;
+    if (page >= sparse.size()) {
+      sparse.resize(page + 1);
+    }
+    if (!sparse[page]) {
+      sparse[page] = std::make_unique<std::uint32_t[]>(PAGE_SIZE);
+      std::fill_n(sparse[page].get(), PAGE_SIZE, NULL_INDEX);
+    }
+    return sparse[page][GetEntityIndex(entity) % PAGE_SIZE];
+  }
+};
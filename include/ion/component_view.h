@@ -0,0 +1,96 @@
+#pragma once
+#include "component_set.h"
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Component types listed here are filtered out of a view.
+// Example: world->View<Transform>(Exclude<Camera>{})
+template <typename... Ts> struct Exclude {};
+
+template <typename Include, typename Filter> class ComponentView;
+
+// Iterates entities that own every component in Ts and none in Us. Iteration
+// is driven by the smallest of the included sets, so its cost is proportional
+// to the rarest component rather than to the total entity count.
+// Note: Adding or removing components of a viewed type while iterating
+// invalidates the view.
+template <typename... Ts, typename... Us>
+class ComponentView<std::tuple<Ts...>, Exclude<Us...>> {
+  static_assert(sizeof...(Ts) > 0, "A view needs at least one component type");
+
+  std::tuple<ComponentSet<Ts> *...> included;
+  std::tuple<ComponentSet<Us> *...> excluded;
+  const std::vector<EntityID> *lead = nullptr;
+
+  bool Matches(EntityID entity) const {
+    return std::apply(
+               [entity](auto *...sets) { return (sets->Contains(entity) && ...); },
+               included) &&
+           std::apply(
+               [entity](auto *...sets) {
+                 return (!sets->Contains(entity) && ...);
+               },
+               excluded);
+  }
+
+public:
+  class Iterator {
+    const ComponentView *view = nullptr;
+    std::size_t index = 0;
+
+    void Skip() {
+      while (index < view->lead->size() &&
+             !view->Matches((*view->lead)[index])) {
+        ++index;
+      }
+    }
+
+  public:
+    Iterator() = default;
+    Iterator(const ComponentView *owner, std::size_t position)
+        : view(owner), index(position) {
+      Skip();
+    }
+    std::tuple<EntityID, Ts &...> operator*() const {
+      auto entity = (*view->lead)[index];
+      return {entity, *std::get<ComponentSet<Ts> *>(view->included)->Get(
+                          entity)...};
+    }
+    Iterator &operator++() {
+      ++index;
+      Skip();
+      return *this;
+    }
+    bool operator==(const Iterator &other) const {
+      return index == other.index;
+    }
+  };
+
+  ComponentView(ComponentSet<Ts> &...include_sets,
+                ComponentSet<Us> &...exclude_sets)
+      : included(&include_sets...), excluded(&exclude_sets...) {
+    std::apply(
+        [this](auto *...sets) {
+          ((lead = (!lead || sets->Size() < lead->size()) ? &sets->Entities()
+                                                          : lead),
+           ...);
+        },
+        included);
+  }
+
+  // Upper bound on the number of matching entities.
+  std::size_t SizeHint() const { return lead->size(); }
+
+  template <typename Func> void Each(Func &&func) const {
+    for (auto entity : *lead) {
+      if (Matches(entity)) {
+        func(entity, *std::get<ComponentSet<Ts> *>(included)->Get(entity)...);
+      }
+    }
+  }
+
+  Iterator begin() const { return {this, 0}; }
+  Iterator end() const { return {this, lead->size()}; }
+};
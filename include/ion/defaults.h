@@ -2,6 +2,12 @@
 #include "exports.h"
 #include <memory>
 
+// Images of the default sprite, relative to the working directory.
+constexpr const char *ION_DEFAULT_COLOR_TEXTURE =
+    "assets/test_sprite/color.png";
+constexpr const char *ION_DEFAULT_NORMAL_TEXTURE =
+    "assets/test_sprite/normal.png";
+
 class Defaults {
 public:
   std::shared_ptr<struct Texture> default_color;
@@ -7,5 +7,6 @@ enum ErrorCodes : std::uint16_t {
   VERTEX_COMPILATION_FAIL = 4,
   FRAGMENT_COMPILATION_FAIL = 5,
   SHADER_PROGRAM_LINK_FAIL = 6,
-  TEXTURE_LOAD_FAIL = 7
+  TEXTURE_LOAD_FAIL = 7,
+  FILE_WRITE_FAIL = 8
 };
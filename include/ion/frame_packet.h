@@ -0,0 +1,83 @@
+#pragma once
+#include "component.h"
+#include "component_set.h"
+#include "exports.h"
+#include "render_queue.h"
+#include "transform_cache.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// The renderable's shader and mesh are held as plain pointers, so copying a
+// sprite into the packet costs no reference counting. The asset registry
+// keeps them alive. Its maps are resolved to the GL textures and uv rect they
+// are drawn from, which differ from the color map's own when it is packed
+// into an atlas page.
+struct ION_API SpriteDraw {
+  EntityID entity = NULL_ENTITY;
+  Affine2D model{};
+  int layer = 0;
+  Shader *shader = nullptr;
+  const GPUData *data = nullptr;
+  unsigned int color_texture = 0;
+  unsigned int normal_texture = 0;
+  glm::vec4 uv_rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+};
+
+// A camera and the sprites it sees, as indices into FramePacket::sprites, in
+// traversal order.
+struct ION_API CameraDraw {
+  glm::mat4 view = glm::mat4(1.0f);
+  glm::mat4 projection = glm::mat4(1.0f);
+  std::vector<std::uint32_t> visible;
+};
+
+struct ION_API CullingStats {
+  std::uint32_t visible = 0;
+  std::uint32_t culled = 0;
+  // In view, but skipped for lacking a shader, mesh or texture.
+  std::uint32_t incomplete = 0;
+};
+
+struct ION_API LightDraw {
+  glm::vec3 position = glm::vec3(0.0f);
+  Light light{};
+};
+
+// Render-relevant state of a World at one tick. Filled on the simulation
+// side by ion::render::ExtractFrame and only read afterwards, so the renderer
+// never touches the live world.
+struct ION_API FramePacket {
+  std::uint32_t tick = 0;
+  std::vector<CameraDraw> cameras;
+  // Sprites visible to at least one camera; off-screen ones are never copied.
+  std::vector<SpriteDraw> sprites;
+  CullingStats culling{};
+  std::vector<LightDraw> lights;
+  // One geometry-pass command per (camera, visible sprite), sorted.
+  RenderQueue queue;
+  // Scratch space of ExtractFrame, kept to reuse its allocations. Holding it
+  // per packet lets packets be extracted on several threads at once.
+  std::vector<std::uint32_t> sprite_slots;
+  std::vector<EntityID> candidates;
+  std::vector<std::uint8_t> visibility;
+  void Clear();
+};
+
+// Hands packets from the simulation thread to the render thread. The writer
+// fills the packet returned by BeginWrite and publishes it; the reader keeps
+// the packet returned by Latest for as long as it draws. Packets the reader
+// has released are recycled, so steady state uses two buffers.
+class ION_API FrameSnapshots {
+  mutable std::mutex mutex;
+  std::shared_ptr<FramePacket> latest;
+  std::shared_ptr<FramePacket> spare;
+
+public:
+  std::shared_ptr<FramePacket> BeginWrite();
+  void Publish(std::shared_ptr<FramePacket> packet);
+  // Most recently published packet, or nullptr before the first Publish.
+  std::shared_ptr<const FramePacket> Latest() const;
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include "exports.h"
+#include <cstdint>
+
+// Shadow copy of the GL bindings the renderer changes. Every call compares
+// against the last value it set and only reaches the driver on a change.
+// All GL binds in ion-base go through here; code issuing GL calls of its own
+// must call Invalidate before handing control back. Objects must be deleted
+// through the Delete* functions, so a recycled GL name is never mistaken for
+// the object that is still bound.
+// Note: GL enums are passed as unsigned int to keep glad out of this header.
+namespace ion::render::gl {
+struct ION_API StateStats {
+  std::uint32_t issued = 0;
+  std::uint32_t skipped = 0;
+};
+
+ION_API void UseProgram(unsigned int program);
+ION_API void BindVertexArray(unsigned int vertex_array);
+// GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_TEXTURE_BUFFER are tracked;
+// other targets always reach the driver. The element buffer binding belongs
+// to the vertex array and is forgotten when the vertex array changes.
+ION_API void BindBuffer(unsigned int target, unsigned int buffer);
+ION_API void ActiveTexture(unsigned int unit);
+// Binds to the active unit. GL_TEXTURE_2D and GL_TEXTURE_BUFFER are tracked.
+ION_API void BindTexture(unsigned int target, unsigned int texture);
+// Binds to the given unit, switching units only if the binding differs.
+ION_API void BindTextureUnit(unsigned int unit, unsigned int target,
+                             unsigned int texture);
+ION_API void BindFramebuffer(unsigned int framebuffer);
+ION_API void Viewport(int x, int y, int width, int height);
+ION_API void SetCapability(unsigned int capability, bool enabled);
+
+ION_API void DeleteProgram(unsigned int program);
+ION_API void DeleteVertexArray(unsigned int vertex_array);
+ION_API void DeleteBuffer(unsigned int buffer);
+ION_API void DeleteTexture(unsigned int texture);
+ION_API void DeleteFramebuffer(unsigned int framebuffer);
+
+// Forgets all shadowed state; the next call of each kind reaches the driver.
+ION_API void Invalidate();
+ION_API StateStats GetStats();
+ION_API void ResetStats();
+} // namespace ion::render::gl
@@ -27,6 +27,10 @@ private:
 
 public:
   unsigned int vertex_attrib = 0, vertex_buffer = 0;
+  // Second vertex array over the same buffers, for instanced draws. Their
+  // per-instance attributes are pointed at the instance data here, so the
+  // mesh's own vertex array is left untouched.
+  unsigned int instance_attrib = 0;
   bool element_enabled = false;
   unsigned int element_buffer = 0;
   const std::string &GetID() const { return id; }
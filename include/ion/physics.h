@@ -7,11 +7,14 @@ namespace ion {
 namespace physics {
 namespace internal {
 ION_API extern b2WorldId world;
+// World tick closed by the last Update; transforms stamped after it were
+// edited outside physics and are pushed to their bodies.
+ION_API extern std::uint32_t last_sync_tick;
 } // namespace internal
 ION_API b2WorldId GetWorld();
 ION_API void Init();
 ION_API void Update(std::shared_ptr<World> &);
-ION_API b2BodyId CreateBody(const std::shared_ptr<Transform> &transform);
+ION_API b2BodyId CreateBody(const Transform &transform);
 ION_API bool BodyIsValid(b2BodyId body);
 ION_API void Quit();
 } // namespace physics
@@ -3,6 +3,8 @@
 #include "gpu_data.h"
 // #include <GLFW/glfw3.h>
 #include "exports.h"
+#include "frame_packet.h"
+#include "transform_cache.h"
 #include <glm/glm.hpp>
 #include <map>
 #include <memory>
@@ -13,6 +15,7 @@ struct Transform;
 struct Texture;
 struct Shader;
 struct World;
+class StreamBuffer;
 
 struct ION_API TextureInfo {
   unsigned char *data;
@@ -23,17 +26,68 @@ struct ION_API TextureInfo {
 
 struct ION_API FramebufferInfo {
   bool enable_colorbuffer = true;
+  // Number of color attachments; all of them are enabled as draw buffers,
+  // attachment i receiving fragment output location i.
+  int color_attachments = 1;
+  // Divides the render resolution, e.g. 2 for a half-resolution target.
+  int downscale = 1;
+  // Bilinear sampling for targets read at a different resolution.
+  bool linear_filter = false;
   bool recreate_on_resize = false;
+  // Drawn into a sub-rect scaled by the dynamic resolution; shaders reading
+  // it scale their texture coordinates by the ION_UV_SCALE uniform.
+  bool dynamic_resolution = false;
+  // Sized to the window instead of the render resolution, e.g. for a target
+  // standing in for the window's own framebuffer.
+  bool window_resolution = false;
   std::string name = "NO_LABEL";
 };
 
 struct ION_API Framebuffer {
   bool recreate_on_resize = false;
+  bool dynamic_resolution = false;
+  bool window_resolution = false;
+  int downscale = 1;
   unsigned int framebuffer = 0;
+  // First color attachment, the one previewed and post-processed.
   unsigned int colorbuffer = 0;
+  std::vector<unsigned int> colorbuffers;
 };
 
-enum RenderPass { RENDER_PASS_COLOR, RENDER_PASS_NORMAL };
+// Color attachments of the geometry pass target.
+enum GBufferAttachment { GBUFFER_ALBEDO, GBUFFER_NORMAL, GBUFFER_COUNT };
+
+struct ION_API DrawStats {
+  std::uint32_t draw_calls = 0;
+  std::uint32_t instances = 0;
+  // Lights uploaded to the deferred pass, and their total tile references.
+  std::uint32_t lights = 0;
+  std::uint32_t light_tile_entries = 0;
+};
+
+// Shrinks the area drawn into dynamic_resolution targets to hold a GPU time
+// budget. Targets keep their full size, so scaling never reallocates them.
+struct ION_API DynamicResolution {
+  bool enabled = false;
+  // Range of the fraction of the render resolution drawn, per axis.
+  float min_scale = 0.5f;
+  float max_scale = 1.0f;
+  // GPU time per frame to hold, in milliseconds.
+  float target_ms = 1000.0f / 60.0f;
+};
+
+struct ION_API FrameTiming {
+  // Wall time between the last two presents.
+  float frame_ms = 0.0f;
+  // GPU time of the newest frame whose timer results arrived, a few frames
+  // behind the one being recorded.
+  float gpu_ms = 0.0f;
+};
+
+struct ION_API PassTiming {
+  std::string name;
+  float gpu_ms = 0.0f;
+};
 
 struct GLFWwindow;
 
@@ -44,12 +98,47 @@ ION_API extern std::map<std::shared_ptr<Framebuffer>, std::string> framebuffers;
 } // namespace internal
 
 int Init();
+// Creates an offscreen context of a fixed size instead of a window, for
+// benchmarks and image tests on machines without a display or GPU. Uses
+// GLFW's null platform where available, with a surfaceless EGL context or,
+// failing that, OSMesa. Surfaceless contexts have no default framebuffer, so
+// headless frames should be drawn into a framebuffer of their own.
+int InitHeadless(glm::ivec2 size);
+bool IsHeadless();
 GLFWwindow *GetWindow();
 glm::vec2 GetWindowSize();
 int GetRenderScale();
 void SetRenderScale(int scale);
 glm::vec3 GetClearColor();
 void SetClearColor(glm::vec3 color);
+// When enabled, visibility queries the world's spatial index; otherwise every
+// sprite's bounds are tested against the view.
+bool GetSpatialCulling();
+void SetSpatialCulling(bool enabled);
+DynamicResolution GetDynamicResolution();
+void SetDynamicResolution(const DynamicResolution &);
+// Fraction of the render resolution drawn this frame, 1 unless dynamic
+// resolution is enabled.
+float GetResolutionScale();
+FrameTiming GetFrameTiming();
+// Bracket the GPU work of a frame. BeginFrame collects finished timings and
+// picks the resolution scale the frame is drawn at.
+void BeginFrame();
+void EndFrame();
+// Ring for data written every frame, opened by BeginFrame and fenced by
+// EndFrame. DrawWorld streams its instance models through it. Allocations
+// only succeed inside that bracket, which BasePipeline::Render opens around
+// graph execution; game code streams from a CustomPass.
+StreamBuffer &GetStreamBuffer();
+// Wraps a pass's GPU work in a GL_TIME_ELAPSED query between BeginFrame and
+// EndFrame. Pass timers do not nest.
+void BeginPassTimer(const std::string &name);
+void EndPassTimer();
+// Passes timed in the frame FrameTiming::gpu_ms belongs to, in order.
+const std::vector<PassTiming> &GetPassTimings();
+// Writes frame,pass,gpu_ms rows for the last few seconds of timed frames,
+// each frame's total under the pass name "Frame". Returns 0 on success.
+int WriteTimingsCSV(const std::string &path);
 
 void ConfigureData(std::shared_ptr<GPUData>);
 void DestroyData(std::shared_ptr<GPUData>);
@@ -59,6 +148,7 @@ void UnbindData();
 unsigned int ConfigureTexture(const TextureInfo &texture_info);
 
 std::shared_ptr<Framebuffer> CreateFramebuffer(const FramebufferInfo &);
+void DestroyFramebuffer(std::shared_ptr<Framebuffer>);
 void UpdateFramebuffers();
 void BindFramebuffer(std::shared_ptr<Framebuffer>);
 void UnbindFramebuffer();
@@ -67,20 +157,43 @@ void DrawFramebuffer(std::shared_ptr<Framebuffer>, std::shared_ptr<Shader>,
 const std::map<std::shared_ptr<Framebuffer>, std::string> &GetFramebuffers();
 
 void BindTexture(std::shared_ptr<Texture> texture, int slot);
-void BindTexture(std::shared_ptr<Framebuffer> framebuffer, int slot);
+void BindTexture(std::shared_ptr<Framebuffer> framebuffer, int slot,
+                 int attachment = 0);
 
 void UseShader(std::shared_ptr<Shader> shader);
 void DestroyShader(std::shared_ptr<Shader>);
 
-void DrawWorld(std::shared_ptr<World>, RenderPass);
+// Copies the render-relevant state of the world into a packet, with world
+// model matrices from World::GetWorldTransforms, and fills its sorted command
+// queue. Call once per tick after simulation; the packet can then be drawn
+// while the world is mutated again.
+void ExtractFrame(std::shared_ptr<World>, FramePacket &);
+// Geometry pass: executes the packet's sorted command queue into the bound
+// G-buffer, albedo and normal in the same draw. Runs of commands sharing
+// camera, layer, shader, GPUData and textures become one instanced draw when
+// the shader has an instanced variant; other sprites are drawn one by one.
+void DrawWorld(const FramePacket &);
+// Frame counters, accumulated by DrawWorld and Render until reset.
+DrawStats GetDrawStats();
+void ResetDrawStats();
 void RunPass(std::shared_ptr<Framebuffer> in, std::shared_ptr<Framebuffer> out,
              std::shared_ptr<Shader> shader, std::shared_ptr<GPUData> quad);
 
 void Clear();
 void Clear(glm::vec4);
-int Render(std::shared_ptr<Framebuffer> color,
-           std::shared_ptr<Framebuffer> normal, std::shared_ptr<GPUData> data,
-           std::shared_ptr<Shader> shader, std::shared_ptr<World> world);
+// Lighting pass over a G-buffer filled by DrawWorld. Lights are uploaded in
+// texture buffers and point lights binned into screen tiles by their reach,
+// so there is no fixed light limit.
+int Render(std::shared_ptr<Framebuffer> gbuffer, std::shared_ptr<GPUData> data,
+           std::shared_ptr<Shader> shader, const FramePacket &packet);
+// Swaps the window's buffers and times the frame. Headless contexts have no
+// buffers to swap and only time it.
 void Present();
+// Writes the first color attachment of framebuffer to a PNG, or without one
+// the window's back buffer; call that before Present. Headless contexts may
+// have no window framebuffer, so draw into a framebuffer there. Returns 0 on
+// success.
+int SaveScreenshot(const std::string &path,
+                   std::shared_ptr<Framebuffer> framebuffer = nullptr);
 int Quit();
 }; // namespace ion::render
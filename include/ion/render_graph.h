@@ -0,0 +1,121 @@
+#pragma once
+#include "exports.h"
+#include "render.h"
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Handle to a framebuffer used by graph passes; valid until Execute.
+using RenderResource = std::uint32_t;
+constexpr RenderResource NULL_RENDER_RESOURCE =
+    std::numeric_limits<RenderResource>::max();
+
+struct ION_API RenderGraphStats {
+  std::uint32_t passes = 0;
+  std::uint32_t culled_passes = 0;
+  std::uint32_t transients = 0;
+  // Pooled framebuffers currently allocated.
+  std::uint32_t targets = 0;
+};
+
+// Per-frame list of passes with declared inputs and outputs. Passes are run
+// in the order they were added. Passes whose outputs reach no imported
+// framebuffer and no side-effecting pass are culled. Transient targets only
+// exist for the passes that use them and are backed by a pool of framebuffers,
+// so transients with disjoint lifetimes share memory.
+// Example:
+//   struct Blur { RenderResource out; };
+//   auto &blur = graph.AddPass<Blur>(
+//       "Blur",
+//       [&](RenderGraph::Builder &builder, Blur &data) {
+//         builder.Read(scene);
+//         data.out = builder.Create(FramebufferInfo{.name = "Blur"});
+//       },
+//       [=](const Blur &data, const RenderGraph &graph) {
+//         ion::render::RunPass(graph.Get(scene), graph.Get(data.out), ...);
+//       });
+class ION_API RenderGraph {
+public:
+  class ION_API Builder {
+    RenderGraph &graph;
+    std::uint32_t pass;
+    Builder(RenderGraph &owner, std::uint32_t index)
+        : graph(owner), pass(index) {}
+    friend class RenderGraph;
+
+  public:
+    // Declares a transient target written by this pass. Only the attachment
+    // count, downscale, filtering and name of the info are used; transients
+    // always follow the render resolution, dynamic resolution included.
+    RenderResource Create(const FramebufferInfo &info);
+    void Read(RenderResource resource);
+    void Write(RenderResource resource);
+    // Keeps the pass even if nothing reads its outputs, e.g. drawing to the
+    // window.
+    void SideEffect();
+  };
+
+  // Registers a persistent framebuffer. Passes writing it are never culled.
+  RenderResource Import(std::shared_ptr<Framebuffer> framebuffer);
+
+  // setup(Builder &, Data &) runs immediately and declares the pass's
+  // resources, storing the handles it needs in data. execute(const Data &,
+  // const RenderGraph &) runs during Execute if the pass survives culling.
+  template <typename Data, typename SetupFunc, typename ExecuteFunc>
+  const Data &AddPass(std::string name, SetupFunc &&setup,
+                      ExecuteFunc &&execute) {
+    auto data = std::make_shared<Data>();
+    auto builder = BeginPass(std::move(name));
+    setup(builder, *data);
+    passes[builder.pass].execute =
+        [data, execute = std::forward<ExecuteFunc>(execute)](
+            const RenderGraph &graph) { execute(*data, graph); };
+    return *data;
+  }
+
+  // Culls, assigns pooled framebuffers, runs the passes and clears the graph
+  // for the next frame. Pooled targets left unused for a while are released.
+  // Each pass run is timed under its name; see ion::render::GetPassTimings.
+  void Execute();
+  // Framebuffer behind a resource. Only valid inside a pass's execute.
+  std::shared_ptr<Framebuffer> Get(RenderResource resource) const;
+  RenderGraphStats GetStats() const { return stats; }
+  // Destroys every pooled framebuffer.
+  void ReleaseTargets();
+
+private:
+  struct Resource {
+    FramebufferInfo info;
+    std::shared_ptr<Framebuffer> framebuffer;
+    bool imported = false;
+    std::uint32_t first_use = NULL_RENDER_RESOURCE;
+    std::uint32_t last_use = 0;
+  };
+  struct Pass {
+    std::string name;
+    std::function<void(const RenderGraph &)> execute;
+    std::vector<RenderResource> reads;
+    std::vector<RenderResource> writes;
+    bool side_effect = false;
+    bool culled = false;
+  };
+  struct Target {
+    FramebufferInfo info;
+    std::shared_ptr<Framebuffer> framebuffer;
+    bool in_use = false;
+    std::uint32_t idle_frames = 0;
+  };
+
+  std::vector<Resource> resources;
+  std::vector<Pass> passes;
+  std::vector<Target> pool;
+  RenderGraphStats stats;
+
+  Builder BeginPass(std::string name);
+  void Cull();
+  std::shared_ptr<Framebuffer> Acquire(const FramebufferInfo &info);
+  void Release(const std::shared_ptr<Framebuffer> &framebuffer);
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include "exports.h"
+#include <cstdint>
+#include <vector>
+
+// Sort key layout, most significant field first. Sorting by key groups
+// commands by pass and camera, draws lower layers first, within a layer
+// brings together commands sharing a shader and then a material, and keeps
+// those in submission order.
+constexpr std::uint32_t SORT_KEY_PASS_BITS = 4;
+constexpr std::uint32_t SORT_KEY_CAMERA_BITS = 6;
+constexpr std::uint32_t SORT_KEY_LAYER_BITS = 12;
+constexpr std::uint32_t SORT_KEY_SHADER_BITS = 10;
+constexpr std::uint32_t SORT_KEY_MATERIAL_BITS = 16;
+constexpr std::uint32_t SORT_KEY_DEPTH_BITS = 16;
+
+enum RenderQueuePass : std::uint8_t { RENDER_QUEUE_GEOMETRY = 0 };
+
+// Key fields before packing. Values wider than their field are clamped, so
+// keys stay ordered but may tie; consumers must not rely on unique keys.
+struct ION_API SortKeyFields {
+  std::uint32_t pass = RENDER_QUEUE_GEOMETRY;
+  std::uint32_t camera = 0;
+  // Signed; stored with a bias so negative layers sort first.
+  int layer = 0;
+  std::uint32_t shader = 0;
+  std::uint32_t material = 0;
+  // Draw order among commands sharing everything above; the submission
+  // index, so the order of the world is kept.
+  std::uint32_t depth = 0;
+};
+ION_API std::uint64_t MakeSortKey(const SortKeyFields &fields);
+
+// One draw as plain data, cheap to copy while sorting.
+struct ION_API DrawCommand {
+  std::uint64_t key = 0;
+  // Indices into FramePacket::sprites and FramePacket::cameras.
+  std::uint32_t sprite = 0;
+  std::uint32_t camera = 0;
+};
+
+// Draw commands emitted during extraction and executed by the backend in key
+// order. Filling the queue touches no GL state, so it can happen on any
+// thread.
+class ION_API RenderQueue {
+  std::vector<DrawCommand> commands;
+  std::vector<DrawCommand> scratch;
+
+public:
+  void Clear() { commands.clear(); }
+  void Reserve(std::size_t count) { commands.reserve(count); }
+  void Push(std::uint64_t key, std::uint32_t sprite, std::uint32_t camera) {
+    commands.push_back(DrawCommand{key, sprite, camera});
+  }
+  // Stable LSD radix sort on the key, one byte per pass. Bytes equal in
+  // every key are skipped, so unused fields cost nothing.
+  void Sort();
+  const std::vector<DrawCommand> &Commands() const { return commands; }
+  std::size_t Size() const { return commands.size(); }
+};
@@ -5,6 +5,8 @@ constexpr const char *ION_SAVE_WORLD = "world";
 constexpr const char *ION_SAVE_MARKER_KEY = "marker";
 constexpr const char *ION_SAVE_MARKER_ID = "id";
 constexpr const char *ION_SAVE_MARKER_VAL = "val";
+constexpr const char *ION_SAVE_PREFAB_KEY = "prefab";
+constexpr const char *ION_SAVE_PREFAB_NAME = "name";
 constexpr const char *ION_SAVE_COMPONENT_KEY = "component";
 constexpr const char *ION_SAVE_COMPONENT_TYPE = "type";
 constexpr const char *ION_SAVE_ENTITY_ID = "entity_id";
@@ -14,6 +16,8 @@ constexpr const char *ION_SAVE_PHYSICS_BODY_KEY = "PhysicsBody";
 constexpr const char *ION_SAVE_LIGHT_KEY = "Light";
 constexpr const char *ION_SAVE_CAMERA_KEY = "Camera";
 constexpr const char *ION_SAVE_SCRIPT_KEY = "Script";
+constexpr const char *ION_SAVE_HIERARCHY_KEY = "Hierarchy";
+constexpr const char *ION_SAVE_HIERARCHY_PARENT = "parent";
 constexpr const char *ION_SAVE_TRANSFORM_POS_X = "pos_x";
 constexpr const char *ION_SAVE_TRANSFORM_POS_Y = "pos_y";
 constexpr const char *ION_SAVE_TRANSFORM_ROTATION = "rotation";
@@ -32,4 +36,8 @@ constexpr const char *ION_SAVE_LIGHT_INTENSITY = "intensity";
 constexpr const char *ION_SAVE_LIGHT_RADIAL_FALLOFF = "radial_falloff";
 constexpr const char *ION_SAVE_LIGHT_VOLUMETRIC_INTENSITY =
     "volumetric_intensity";
-constexpr const char *ION_SAVE_SCRIPT_PATH = "script_path";
\ No newline at end of file
+constexpr const char *ION_SAVE_SCRIPT_PATH = "script_path";
+constexpr const char *ION_SAVE_SCRIPT_MODULE = "module";
+constexpr const char *ION_SAVE_SCRIPT_PARAMETER_KEY = "parameter";
+constexpr const char *ION_SAVE_SCRIPT_PARAMETER_NAME = "name";
+constexpr const char *ION_SAVE_SCRIPT_PARAMETER_VAL = "val";
\ No newline at end of file
@@ -1,18 +1,64 @@
 #pragma once
+#include <cstdint>
 #include <filesystem>
 #include <string>
+#include <string_view>
+#include <vector>
+
+// FNV-1a hash of a uniform name. Constant names can be hashed at compile
+// time: constexpr UniformID VIEW{"view"};
+struct UniformID {
+  std::uint32_t hash = 2166136261u;
+  constexpr explicit UniformID(std::string_view name) {
+    for (auto character : name) {
+      hash ^= static_cast<unsigned char>(character);
+      hash *= 16777619u;
+    }
+  }
+};
+
+// Active uniforms of a linked program, reflected once after linking. Array
+// elements are listed individually ("lights[3].color", "weights[2]").
+class UniformTable {
+  struct Slot {
+    std::uint32_t hash;
+    int location;
+  };
+  // Sorted by hash.
+  std::vector<Slot> slots;
+
+public:
+  void Reflect(unsigned int program);
+  // Location of the uniform, or -1 (ignored by glUniform*) if inactive.
+  int Find(UniformID id) const;
+  std::size_t Size() const { return slots.size(); }
+};
 
 struct Shader {
 private:
   unsigned int program;
+  unsigned int instanced_program = 0;
+  // Program selected by the last Use/UseInstanced; SetUniform targets it.
+  unsigned int active_program = 0;
+  UniformTable uniforms;
+  UniformTable instanced_uniforms;
   std::string id;
   std::filesystem::path path;
 
 public:
   void Use();
+  // Binds the variant built from vs_instanced.glsl, if the shader has one.
+  void UseInstanced();
+  bool HasInstancedVariant() const { return instanced_program != 0; }
   std::string GetID() const { return id; }
   std::filesystem::path GetPath() const { return path; }
   unsigned int GetProgram();
-  template <typename T> int SetUniform(std::string_view name, T value);
+  unsigned int GetInstancedProgram() const { return instanced_program; }
+  // Location of a uniform in the active program, or -1.
+  int GetUniformLocation(UniformID id) const;
+  template <typename T> int SetUniform(UniformID id, T value);
+  template <typename T> int SetUniform(std::string_view name, T value) {
+    return SetUniform(UniformID(name), value);
+  }
   explicit Shader(std::filesystem::path path, std::string_view new_id);
 };
@@ -0,0 +1,85 @@
+#pragma once
+#include "component.h"
+#include "component_set.h"
+#include "exports.h"
+#include "transform_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+struct ION_API AABB {
+  glm::vec2 min = glm::vec2(0.0f);
+  glm::vec2 max = glm::vec2(0.0f);
+  bool Overlaps(const AABB &other) const {
+    return min.x <= other.max.x && max.x >= other.min.x &&
+           min.y <= other.max.y && max.y >= other.min.y;
+  }
+};
+
+struct ION_API RayHit {
+  EntityID entity = NULL_ENTITY;
+  float distance = 0.0f;
+};
+
+// World-space bounds of the unit quad placed by a transform, rotation
+// included.
+ION_API AABB GetTransformBounds(const Transform &transform);
+ION_API AABB GetModelBounds(const Affine2D &model);
+
+// Uniform hash grid over entity bounds. Each entity is listed in every cell
+// its bounds touch; queries only visit the cells they overlap, so their cost
+// depends on local density rather than on world size.
+// Note: Queries are const but not safe to run concurrently.
+class ION_API SpatialIndex {
+public:
+  explicit SpatialIndex(float cell_size = 4.0f);
+
+  // World tick the index was last synced to, see World::GetSpatialIndex.
+  std::uint32_t synced_tick = 0;
+  // Re-inserts entities whose world model was recomputed after tick since and
+  // drops entities that no longer have a transform. since == 0 rebuilds from
+  // scratch.
+  void Sync(const ComponentSet<Transform> &transforms,
+            const TransformCache &world_transforms, std::uint32_t since);
+
+  // Inserts the entity or moves it to new bounds.
+  void Insert(EntityID entity, const AABB &bounds);
+  void Remove(EntityID entity);
+  void Clear();
+  std::size_t Size() const { return entries.size(); }
+  float GetCellSize() const { return cell_size; }
+  const AABB *GetBounds(EntityID entity) const;
+
+  // Queries append to out, each entity at most once.
+  void QueryAABB(const AABB &box, std::vector<EntityID> &out) const;
+  void QueryRadius(glm::vec2 center, float radius,
+                   std::vector<EntityID> &out) const;
+  // Entities whose bounds the segment origin + t * direction crosses for t
+  // in [0, max_distance], nearest first. direction need not be normalized.
+  void Raycast(glm::vec2 origin, glm::vec2 direction, float max_distance,
+               std::vector<RayHit> &out) const;
+
+private:
+  struct Entry {
+    AABB bounds;
+    glm::ivec2 min_cell;
+    glm::ivec2 max_cell;
+    mutable std::uint32_t query_stamp = 0;
+  };
+
+  float cell_size;
+  std::unordered_map<EntityID, Entry> entries;
+  std::unordered_map<std::uint64_t, std::vector<EntityID>> cells;
+  // Grow-only union of all inserted bounds; limits ray traversal.
+  AABB extent{};
+  mutable std::uint32_t query_stamp = 0;
+
+  glm::ivec2 CellOf(glm::vec2 point) const;
+  void Link(EntityID entity, glm::ivec2 min_cell, glm::ivec2 max_cell);
+  void Unlink(EntityID entity, glm::ivec2 min_cell, glm::ivec2 max_cell);
+  // Calls func(entity, entry) once per entity listed in the cell range.
+  template <typename Func>
+  void Visit(glm::ivec2 min_cell, glm::ivec2 max_cell, Func &&func) const;
+};
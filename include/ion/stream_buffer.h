@@ -0,0 +1,76 @@
+#pragma once
+#include "exports.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bytes of the current frame's section handed out by StreamBuffer::Allocate.
+// data is write-only memory; draws read it from buffer at offset.
+struct ION_API StreamAllocation {
+  void *data = nullptr;
+  unsigned int buffer = 0;
+  std::size_t offset = 0;
+  std::size_t size = 0;
+  explicit operator bool() const { return data != nullptr; }
+};
+
+struct ION_API StreamBufferStats {
+  std::size_t used = 0;
+  std::size_t section_size = 0;
+  // Frames that found their section still in use by the GPU and had to wait.
+  std::uint32_t waits = 0;
+  bool persistent = false;
+};
+
+// Ring of FRAMES sections in one GL buffer for data written every frame,
+// such as instance transforms. Each frame writes into its own section, which
+// is fenced at EndFrame and only reused once the GPU has passed the fence, so
+// uploads never wait on draws still reading earlier frames.
+// With GL_ARB_buffer_storage the buffer is mapped persistently and writes
+// land in it directly. Otherwise writes are staged and copied into the
+// section through unsynchronized maps at Flush.
+// Example:
+//   auto allocation = stream.Allocate(count * sizeof(Vertex));
+//   std::memcpy(allocation.data, vertices, allocation.size);
+//   stream.Flush();
+//   // draw from allocation.buffer at allocation.offset
+class ION_API StreamBuffer {
+public:
+  static constexpr int FRAMES = 3;
+
+  // Waits for the GPU to finish the frame that last used this section, then
+  // opens it. Grows the ring first if an earlier frame ran out of space, and
+  // replaces the buffer if the wait timed out.
+  void BeginFrame();
+  // Sub-allocates size bytes of the current section. Returns an empty
+  // allocation outside BeginFrame/EndFrame or when the section is full; the
+  // ring is then enlarged for the following frames.
+  StreamAllocation Allocate(std::size_t size, std::size_t alignment = 16);
+  // Makes writes to allocations visible to draws issued after it.
+  void Flush();
+  // Flushes and fences the frame's section.
+  void EndFrame();
+  // Deletes the buffer and fences.
+  void Release();
+  StreamBufferStats GetStats() const;
+
+private:
+  unsigned int buffer = 0;
+  // Persistent mapping of the whole buffer, when supported.
+  unsigned char *mapped = nullptr;
+  bool persistent = false;
+  std::array<void *, FRAMES> fences{};
+  int section = 0;
+  std::size_t section_size = 0;
+  std::size_t used = 0;
+  std::size_t flushed = 0;
+  // Bytes asked for this frame, including allocations that did not fit.
+  std::size_t requested = 0;
+  bool in_frame = false;
+  // Copy of the frame's writes without a persistent mapping.
+  std::vector<unsigned char> staging;
+  std::uint32_t waits = 0;
+
+  void Create(std::size_t size);
+};
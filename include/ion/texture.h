@@ -1,5 +1,6 @@
 #pragma once
 #include <filesystem>
+#include <glm/glm.hpp>
 #include <memory>
 #include <string>
 
@@ -9,6 +10,18 @@ struct Texture {
 
 public:
   unsigned int texture = 0;
+  // Area of the image within texture as (offset, size) in texture
+  // coordinates. Covers the whole texture unless it was packed into an atlas
+  // page. The page holding packed_normal, the normal map it was packed with,
+  // is then normal_page, and source_texture still holds the image alone for
+  // sprites that pair it with another normal map.
+  glm::vec4 uv_rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+  unsigned int normal_page = 0;
+  unsigned int source_texture = 0;
+  std::shared_ptr<Texture> packed_normal;
+  // Set while an asynchronous load is pending; texture is the placeholder.
+  // Cleared with texture set to 0 if the load is dropped.
+  bool loading = false;
   Texture(std::filesystem::path new_path, std::string_view new_id)
       : path(new_path), id(new_id) {}
   std::filesystem::path GetPath() const { return path; }
@@ -0,0 +1,64 @@
+#pragma once
+#include "exports.h"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+struct Texture;
+struct World;
+
+// Bottom-left skyline packer: places each rectangle where its top edge ends
+// lowest, tracking only the upper outline of what was placed so far.
+class ION_API SkylinePacker {
+public:
+  explicit SkylinePacker(glm::ivec2 page_size);
+  // Finds a spot for a rectangle of size, or returns false if none is left.
+  bool Insert(glm::ivec2 size, glm::ivec2 &position);
+  // Highest top edge so far, i.e. the page height actually used.
+  int GetHeight() const;
+
+private:
+  struct Segment {
+    int x;
+    int y;
+    int width;
+  };
+  glm::ivec2 size;
+  std::vector<Segment> skyline;
+
+  // Top of a rectangle of size placed at segment index, or -1 if it does not
+  // fit there.
+  int Fit(std::size_t index, glm::ivec2 size) const;
+};
+
+// A page of packed color maps and a normal page with the normal map of each
+// sprite at the same spot, so one uv_rect addresses both.
+struct ION_API AtlasPage {
+  unsigned int color = 0;
+  unsigned int normal = 0;
+  glm::ivec2 size = glm::ivec2(0);
+  std::uint32_t sprites = 0;
+  // World the page was built for, and the color maps packed into it.
+  const World *world = nullptr;
+  std::vector<std::shared_ptr<Texture>> textures;
+};
+
+namespace ion::res {
+// Packs the color maps of the world's renderables into shared atlas pages.
+// Renderables loading the same image share one Texture, which is what lets
+// the pairing checks below see shared color and normal maps.
+// Packed textures then refer to their page, with a uv_rect the sprite shaders
+// apply and the page of their normal map in normal_page, so sprites sharing
+// a page batch together. Colors that are already packed, still loading, used
+// with several normal maps or as a normal map, sized differently from their
+// normal map or too large for a page keep their own texture. Returns how
+// many were packed.
+ION_API std::size_t BuildTextureAtlas(std::shared_ptr<World> world);
+// Returns the textures packed for world, or for every world when nullptr, to
+// their own images and deletes their pages. Worlds release theirs when they
+// are destroyed.
+ION_API void ReleaseTextureAtlas(const World *world = nullptr);
+ION_API const std::vector<AtlasPage> &GetAtlasPages();
+} // namespace ion::res
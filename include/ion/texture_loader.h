@@ -0,0 +1,38 @@
+#pragma once
+#include "exports.h"
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+struct Texture;
+struct World;
+
+namespace ion::res {
+// When enabled, LoadAsset<Texture> returns at once with a Texture showing
+// the placeholder (the default sprite) while worker threads copy and decode
+// the image into a mapped pixel buffer; UpdateTextureLoads then uploads it.
+// Off by default.
+ION_API void SetAsyncTextureLoading(bool enabled);
+ION_API bool GetAsyncTextureLoading();
+// Maps pixel buffers for the workers, starts the transfer of filled ones and
+// swaps in the textures transferred by the previous call, until budget_ms has
+// passed. Builds the deferred texture atlases once no loads are pending.
+// Call once per frame on the thread owning the GL context.
+ION_API void UpdateTextureLoads(float budget_ms = 2.0f);
+// Textures requested but not uploaded yet.
+ION_API std::size_t GetPendingTextureLoads();
+// Stops the workers and drops loads that have not finished; their textures
+// are left without an image and no longer loading. Deletes the placeholder.
+// render::Quit calls this as well.
+ION_API void StopTextureLoads();
+
+namespace internal {
+// Queues the image for the texture id. A non-empty source is copied into the
+// project root first.
+ION_API std::shared_ptr<Texture>
+LoadTextureAsync(const std::filesystem::path &source, const std::string &id);
+// Builds the world's texture atlas now, or once the pending loads finish.
+ION_API void BuildTextureAtlasWhenLoaded(std::shared_ptr<World> world);
+} // namespace internal
+} // namespace ion::res
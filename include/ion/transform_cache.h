@@ -0,0 +1,85 @@
+#pragma once
+#include "component.h"
+#include "component_set.h"
+#include "exports.h"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Compact model matrix for a 2D sprite. Columns are the scaled x and y axes
+// followed by the translation; the layer becomes the z translation.
+struct ION_API Affine2D {
+  float a = 1.0f, b = 0.0f;
+  float c = 0.0f, d = 1.0f;
+  float tx = 0.0f, ty = 0.0f;
+  float layer = 0.0f;
+  float padding = 0.0f;
+  glm::mat4 ToMat4() const;
+  glm::vec2 TransformPoint(glm::vec2 point) const {
+    return glm::vec2(a * point.x + c * point.y + tx,
+                     b * point.x + d * point.y + ty);
+  }
+  Affine2D Inverse() const;
+};
+
+// parent * local, with layers adding up like the z translation they stand for.
+ION_API Affine2D Combine(const Affine2D &parent, const Affine2D &local);
+
+// Structure-of-arrays copy of a Transform set, index-aligned with the dense
+// order of the ComponentSet it was gathered from.
+struct ION_API TransformStreams {
+  std::vector<float> position_x;
+  std::vector<float> position_y;
+  std::vector<float> layer;
+  std::vector<float> scale_x;
+  std::vector<float> scale_y;
+  std::vector<float> rotation;
+  std::size_t Size() const { return position_x.size(); }
+  void Gather(const ComponentSet<Transform> &transforms);
+};
+
+// World-space model matrices for every Transform in a world, index-aligned
+// with the dense order of the Transform set.
+struct ION_API TransformCache {
+  static constexpr std::uint32_t NO_PARENT =
+      ComponentSet<Transform>::NULL_INDEX;
+
+  TransformStreams streams;
+  // Local models; only kept while the world has a hierarchy; otherwise the
+  // local model is the world model.
+  std::vector<Affine2D> locals;
+  std::vector<Affine2D> models;
+  // Tick each model was last recomputed at, for consumers of world matrices.
+  std::vector<std::uint32_t> versions;
+  // Dense parent index per transform, and all indices in breadth-first order
+  // so parents are always resolved before their children.
+  std::vector<std::uint32_t> parents;
+  std::vector<std::uint32_t> order;
+  // Scratch flags marking models recomputed during the current Update.
+  std::vector<std::uint8_t> dirty;
+  // Set the cache was last built from and the world tick it is current to.
+  const ComponentSet<Transform> *source = nullptr;
+  std::uint32_t synced_tick = 0;
+
+  // Recomputes the world models affected by changes after tick since: the
+  // changed transforms and every descendant of them. Falls back to a full
+  // rebuild when either set was restructured, a parent link changed or the
+  // transforms are a different set. Recomputed models are stamped with tick.
+  void Update(const ComponentSet<Transform> &transforms,
+              const ComponentSet<Hierarchy> &hierarchies, std::uint32_t since,
+              std::uint32_t tick);
+  const Affine2D *Get(const ComponentSet<Transform> &transforms,
+                      EntityID entity) const;
+};
+
+namespace ion::render {
+// Builds one Affine2D per stream element. Uses SSE2 four entities at a time
+// where available, scalar code otherwise.
+ION_API void ComputeAffineModels(const TransformStreams &streams,
+                                 Affine2D *out);
+// Sets visible[i] to 1 if the bounds of models[i]'s unit quad overlap the
+// rectangle [min, max], 0 otherwise. Uses SSE2 where available.
+ION_API void CullModels(const Affine2D *models, std::size_t count,
+                        glm::vec2 min, glm::vec2 max, std::uint8_t *visible);
+} // namespace ion::render
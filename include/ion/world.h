@@ -1,58 +1,214 @@
 #pragma once
 
 #include "component.h"
+#include "component_registry.h"
+#include "component_set.h"
+#include "component_view.h"
 #include "render.h"
+#include "spatial_index.h"
 #include <filesystem>
 #include <map>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
-using EntityID = std::uint32_t;
-const EntityID NULL_ENTITY = std::numeric_limits<EntityID>::max();
+// Component template for spawning many identical entities at once.
+struct ION_API Prefab {
+  Transform transform{};
+  std::optional<Renderable> renderable{};
+  std::optional<PhysicsBody> physics_body{};
+  std::optional<Light> light{};
+  std::optional<Camera> camera{};
+  std::optional<Script> script{};
+};
+
+// Entities with consecutive IDs, as returned by bulk creation.
+struct ION_API EntityRange {
+  EntityID first = NULL_ENTITY;
+  std::uint32_t count = 0;
+  EntityID operator[](std::uint32_t i) const { return first + i; }
+};
 
 struct World {
 private:
-  EntityID next_id = 1;
+  static constexpr std::uint32_t FREE_SLOT_INDEX = ENTITY_INDEX_MASK;
+
+  // Live handle per slot index. Free slots hold FREE_SLOT_INDEX in their
+  // index bits and the generation the slot will be reissued with.
+  std::vector<EntityID> slots{NULL_ENTITY};
+  // Slot indices available for reuse. May contain indices that have been
+  // restored since they were freed; those are skipped on reuse.
+  std::vector<std::uint32_t> free_indices{};
+  std::size_t entity_count = 0;
+  std::uint32_t tick = 1;
   std::map<EntityID, std::string> markers{};
-  std::map<EntityID, std::shared_ptr<Transform>> transforms{};
-  std::map<EntityID, std::shared_ptr<Renderable>> renderables{};
-  std::map<EntityID, std::shared_ptr<PhysicsBody>> physics_bodies{};
-  std::map<EntityID, std::shared_ptr<Camera>> cameras{};
-  std::map<EntityID, std::shared_ptr<Light>> lights{};
-  std::map<EntityID, std::shared_ptr<Script>> scripts{};
-  std::map<EntityID, std::shared_ptr<void *>> custom_components{};
+  std::map<std::string, Prefab> prefabs{};
+  ComponentSet<Transform> transforms{};
+  ComponentSet<Renderable> renderables{};
+  ComponentSet<PhysicsBody> physics_bodies{};
+  ComponentSet<Camera> cameras{};
+  ComponentSet<Light> lights{};
+  ComponentSet<Script> scripts{};
+  ComponentSet<Hierarchy> hierarchies{};
+  // Pools for component types outside the built-in set, indexed by
+  // GetComponentTypeID<T>() and created on first use.
+  std::vector<std::unique_ptr<ComponentPool>> custom_pools{};
+  TransformCache transform_cache{};
+  SpatialIndex spatial_index{};
   std::filesystem::path world_path;
 
+  EntityRange AllocateEntities(std::uint32_t count);
+  // Removes the components and marker of one entity and recycles its slot.
+  void ReleaseEntity(EntityID entity);
+
 public:
   World(std::filesystem::path path) : world_path(path) {}
+  // Releases the texture atlas pages built for the world.
+  ~World();
   std::filesystem::path GetWorldPath() const { return world_path; }
   std::map<EntityID, std::string> &GetMarkers();
+  std::map<std::string, Prefab> &GetPrefabs();
   // Creates a new entity and returns its ID
   // Note: Adds a transform component after creating an entity
   EntityID CreateEntity();
+  // Creates count entities with default transforms in one pass. The IDs are
+  // taken from fresh slots so they are consecutive.
+  EntityRange CreateEntities(std::uint32_t count);
+  // Creates count copies of the prefab. Component storage is grown once per
+  // type; physics bodies are created per entity.
+  EntityRange Instantiate(const Prefab &prefab, std::uint32_t count = 1);
+  // Marks a specific handle as alive, e.g. when loading a saved world.
+  void RestoreEntity(EntityID entity);
+  // Removes every component and marker of the entity and recycles its slot,
+  // then destroys its children. Does nothing for stale or null handles.
   void DestroyEntity(EntityID entity);
-  EntityID GetNextEntityID() const { return next_id; }
-
-  template <typename T>
-  std::map<EntityID, std::shared_ptr<T>> &GetComponentSet();
+  bool IsValid(EntityID entity) const {
+    auto index = GetEntityIndex(entity);
+    return index != FREE_SLOT_INDEX && index < slots.size() &&
+           slots[index] == entity;
+  }
+  std::size_t GetEntityCount() const { return entity_count; }
+  // Makes child's Transform relative to parent. NULL_ENTITY detaches it.
+  // The local transform is kept, so the child moves unless it is adjusted.
+  // Does nothing if parent is child or one of its descendants.
+  void SetParent(EntityID child, EntityID parent);
+  EntityID GetParent(EntityID entity);
+  // World-space model matrices of every transform, with parents applied.
+  // Only transforms changed since the last call, and their descendants, are
+  // recomputed.
+  const TransformCache &GetWorldTransforms();
+  // Spatial index over world-space transform bounds, brought up to date with every
+  // transform change before it is returned.
+  // Example: world->GetSpatialIndex().QueryRadius(position, 2.0f, nearby);
+  SpatialIndex &GetSpatialIndex();
 
-  template <typename T> std::shared_ptr<T> NewComponent(EntityID entity) {
-    GetComponentSet<T>().insert({entity, std::make_shared<T>()});
-    return GetComponentSet<T>().at(entity);
+  // Storage for T. Built-in types map to dedicated members; any other type
+  // gets its own pool, so game code can attach components without
+  // registering them anywhere.
+  // Example: struct Health { int value = 100; };
+  //          world->NewComponent<Health>(id)->value = 50;
+  template <typename T> ComponentSet<T> &GetComponentSet() {
+    auto id = GetComponentTypeID<T>();
+    if (id >= custom_pools.size()) {
+      custom_pools.resize(id + 1);
+    }
+    if (!custom_pools[id]) {
+      auto pool = std::make_unique<TypedComponentPool<T>>();
+      pool->set.SetTick(tick);
+      custom_pools[id] = std::move(pool);
+    }
+    return static_cast<TypedComponentPool<T> &>(*custom_pools[id]).set;
   }
 
-  template <typename T> std::shared_ptr<T> GetComponent(EntityID entity) {
-    auto it = GetComponentSet<T>().find(entity);
-    if (it != GetComponentSet<T>().end()) {
-      return it->second;
+  // Components are stored by value; the returned pointer is only valid until
+  // the next insertion into or removal from the same component set.
+  // Returns nullptr for stale or null handles.
+  template <typename T> T *NewComponent(EntityID entity) {
+    if (!IsValid(entity)) {
+      return nullptr;
     }
-    return nullptr;
+    return GetComponentSet<T>().Emplace(entity);
+  }
+
+  template <typename T> T *GetComponent(EntityID entity) {
+    return GetComponentSet<T>().Get(entity);
   }
 
   template <typename T> bool ContainsComponent(EntityID entity) {
-    return GetComponentSet<T>().contains(entity);
+    return GetComponentSet<T>().Contains(entity);
   }
 
   template <typename T> void RemoveComponent(EntityID entity) {
-    GetComponentSet<T>().erase(entity);
+    GetComponentSet<T>().Remove(entity);
+  }
+
+  // Change ticks. Every insertion and reported edit is stamped with the
+  // current tick. A consumer remembers the value returned by AdvanceTick and
+  // later asks for changes since it; its own writes before that call are
+  // excluded.
+  std::uint32_t GetTick() const { return tick; }
+  // Closes the current tick and returns it.
+  std::uint32_t AdvanceTick();
+
+  // Applies func to the entity's component and stamps it as changed.
+  // Returns the component, or nullptr if the entity does not own one.
+  // Example: world->Patch<Transform>(id, [](Transform &t) { t.layer = 2; });
+  template <typename T, typename Func> T *Patch(EntityID entity, Func &&func) {
+    auto &set = GetComponentSet<T>();
+    auto component = set.Get(entity);
+    if (component) {
+      func(*component);
+      set.MarkChanged(entity);
+    }
+    return component;
+  }
+
+  // Stamps a component that was edited in place as changed.
+  template <typename T> void MarkChanged(EntityID entity) {
+    GetComponentSet<T>().MarkChanged(entity);
+  }
+
+  template <typename T> bool ChangedSince(EntityID entity, std::uint32_t since) {
+    return GetComponentSet<T>().ChangedSince(entity, since);
+  }
+
+  // Calls func(EntityID, T &) for every component of type T inserted or
+  // changed after tick since.
+  template <typename T, typename Func>
+  void EachChanged(std::uint32_t since, Func &&func) {
+    auto &set = GetComponentSet<T>();
+    auto &versions = set.Versions();
+    auto &entities = set.Entities();
+    auto &components = set.Components();
+    for (std::size_t i = 0; i < versions.size(); i++) {
+      if (versions[i] > since) {
+        func(entities[i], components[i]);
+      }
+    }
+  }
+
+  // Entities that own all of Ts and none of Us, yielded as
+  // (EntityID, Ts &...) tuples.
+  // Example: for (auto [id, transform, renderable] :
+  //               world->View<Transform, Renderable>()) {}
+  template <typename... Ts, typename... Us>
+  ComponentView<std::tuple<Ts...>, Exclude<Us...>>
+  View(Exclude<Us...> = {}) {
+    return {GetComponentSet<Ts>()..., GetComponentSet<Us>()...};
+  }
+
+  // Calls func(EntityID, Ts &...) for every entity in View<Ts...>.
+  template <typename... Ts, typename... Us, typename Func>
+  void Each(Func &&func, Exclude<Us...> exclude = {}) {
+    View<Ts...>(exclude).Each(std::forward<Func>(func));
   }
 };
+
+template <> ComponentSet<Transform> &World::GetComponentSet<Transform>();
+template <> ComponentSet<Renderable> &World::GetComponentSet<Renderable>();
+template <> ComponentSet<PhysicsBody> &World::GetComponentSet<PhysicsBody>();
+template <> ComponentSet<Camera> &World::GetComponentSet<Camera>();
+template <> ComponentSet<Light> &World::GetComponentSet<Light>();
+template <> ComponentSet<Script> &World::GetComponentSet<Script>();
+template <> ComponentSet<Hierarchy> &World::GetComponentSet<Hierarchy>();
@@ -15,6 +15,8 @@
 #include "ion/physics.h"
 #include "ion/render.h"
 #include "ion/save_keys.h"
+#include "ion/texture_atlas.h"
+#include "ion/texture_loader.h"
 #include "stb_image.h"
 
 namespace ion::res::internal {
@@ -26,6 +28,143 @@ ION_API std::map<std::string, std::shared_ptr<void>> custom_assets;
 ION_API std::filesystem::path project_root;
 } // namespace ion::res::internal
 
+static void ReadTransform(pugi::xml_node transform_node,
+                          Transform &transform) {
+  transform.position.x =
+      transform_node.attribute(ION_SAVE_TRANSFORM_POS_X).as_float();
+  transform.position.y =
+      transform_node.attribute(ION_SAVE_TRANSFORM_POS_Y).as_float();
+  transform.rotation = transform_node.attribute(ION_SAVE_TRANSFORM_ROTATION)
+                           .as_float(transform.rotation);
+  transform.scale.x = transform_node.attribute(ION_SAVE_TRANSFORM_SCALE_X)
+                          .as_float(transform.scale.x);
+  transform.scale.y = transform_node.attribute(ION_SAVE_TRANSFORM_SCALE_Y)
+                          .as_float(transform.scale.y);
+}
+static void ReadRenderable(pugi::xml_node renderable_node,
+                           Renderable &renderable) {
+  renderable.color = ion::res::LoadAsset<Texture>(
+      renderable_node.attribute(ION_SAVE_RENDERABLE_COLOR).as_string());
+  renderable.normal = ion::res::LoadAsset<Texture>(
+      renderable_node.attribute(ION_SAVE_RENDERABLE_NORMAL).as_string());
+  renderable.shader = ion::res::LoadAsset<Shader>(
+      renderable_node.attribute(ION_SAVE_RENDERABLE_SHADER).as_string());
+  renderable.data = ion::res::LoadAsset<GPUData>(
+      renderable_node.attribute(ION_SAVE_RENDERABLE_GPU_DATA).as_string());
+}
+static void ReadLight(pugi::xml_node light_node, Light &light) {
+  light.type =
+      static_cast<LightType>(light_node.attribute(ION_SAVE_LIGHT_TYPE).as_int());
+  light.intensity =
+      light_node.attribute(ION_SAVE_LIGHT_INTENSITY).as_float(light.intensity);
+  light.radial_falloff = light_node.attribute(ION_SAVE_LIGHT_RADIAL_FALLOFF)
+                             .as_float(light.radial_falloff);
+  light.volumetric_intensity =
+      light_node.attribute(ION_SAVE_LIGHT_VOLUMETRIC_INTENSITY)
+          .as_float(light.volumetric_intensity);
+  light.color.r =
+      light_node.attribute(ION_SAVE_LIGHT_COLOR_R).as_float(light.color.r);
+  light.color.g =
+      light_node.attribute(ION_SAVE_LIGHT_COLOR_G).as_float(light.color.g);
+  light.color.b =
+      light_node.attribute(ION_SAVE_LIGHT_COLOR_B).as_float(light.color.b);
+}
+static void ReadScript(pugi::xml_node script_node, Script &script) {
+  script.path = script_node.attribute(ION_SAVE_SCRIPT_PATH).as_string();
+  script.module_name = script_node.attribute(ION_SAVE_SCRIPT_MODULE)
+                           .as_string(script.module_name.c_str());
+  for (auto parameter_node :
+       script_node.children(ION_SAVE_SCRIPT_PARAMETER_KEY)) {
+    auto name =
+        parameter_node.attribute(ION_SAVE_SCRIPT_PARAMETER_NAME).as_string();
+    script.parameters[name] =
+        parameter_node.attribute(ION_SAVE_SCRIPT_PARAMETER_VAL).as_string();
+  }
+}
+static void ReadPrefab(pugi::xml_node prefab_node, Prefab &prefab) {
+  for (auto component_node : prefab_node.children(ION_SAVE_COMPONENT_KEY)) {
+    auto type = std::string(
+        component_node.attribute(ION_SAVE_COMPONENT_TYPE).as_string());
+    if (type == ION_SAVE_TRANSFORM_KEY) {
+      ReadTransform(component_node.child(ION_SAVE_TRANSFORM_KEY),
+                    prefab.transform);
+    } else if (type == ION_SAVE_RENDERABLE_KEY) {
+      ReadRenderable(component_node.child(ION_SAVE_RENDERABLE_KEY),
+                     prefab.renderable.emplace());
+    } else if (type == ION_SAVE_PHYSICS_BODY_KEY) {
+      prefab.physics_body.emplace();
+    } else if (type == ION_SAVE_LIGHT_KEY) {
+      ReadLight(component_node.child(ION_SAVE_LIGHT_KEY),
+                prefab.light.emplace());
+    } else if (type == ION_SAVE_CAMERA_KEY) {
+      prefab.camera.emplace();
+    } else if (type == ION_SAVE_SCRIPT_KEY) {
+      ReadScript(component_node.child(ION_SAVE_SCRIPT_KEY),
+                 prefab.script.emplace());
+    }
+  }
+}
+
+// Appends <component type="..."><Type/></component> and returns <Type/>.
+static pugi::xml_node AppendComponent(pugi::xml_node parent, const char *type,
+                                      EntityID entity_id = NULL_ENTITY) {
+  auto component_node = parent.append_child(ION_SAVE_COMPONENT_KEY);
+  component_node.append_attribute(ION_SAVE_COMPONENT_TYPE) = type;
+  if (entity_id != NULL_ENTITY) {
+    component_node.append_attribute(ION_SAVE_ENTITY_ID) = entity_id;
+  }
+  return component_node.append_child(type);
+}
+static void WriteTransform(pugi::xml_node transform_node,
+                           const Transform &transform) {
+  transform_node.append_attribute(ION_SAVE_TRANSFORM_POS_X) =
+      transform.position.x;
+  transform_node.append_attribute(ION_SAVE_TRANSFORM_POS_Y) =
+      transform.position.y;
+  transform_node.append_attribute(ION_SAVE_TRANSFORM_ROTATION) =
+      transform.rotation;
+  transform_node.append_attribute(ION_SAVE_TRANSFORM_SCALE_X) =
+      transform.scale.x;
+  transform_node.append_attribute(ION_SAVE_TRANSFORM_SCALE_Y) =
+      transform.scale.y;
+}
+static void WriteRenderable(pugi::xml_node renderable_node,
+                            const Renderable &renderable) {
+  renderable_node.append_attribute(ION_SAVE_RENDERABLE_COLOR) =
+      renderable.color->GetID().c_str();
+  renderable_node.append_attribute(ION_SAVE_RENDERABLE_NORMAL) =
+      renderable.normal->GetID().c_str();
+  renderable_node.append_attribute(ION_SAVE_RENDERABLE_SHADER) =
+      renderable.shader->GetID().c_str();
+  renderable_node.append_attribute(ION_SAVE_RENDERABLE_GPU_DATA) =
+      renderable.data->GetID().c_str();
+}
+static void WriteLight(pugi::xml_node light_node, const Light &light) {
+  light_node.append_attribute(ION_SAVE_LIGHT_COLOR_R) = light.color.r;
+  light_node.append_attribute(ION_SAVE_LIGHT_COLOR_G) = light.color.g;
+  light_node.append_attribute(ION_SAVE_LIGHT_COLOR_B) = light.color.b;
+  light_node.append_attribute(ION_SAVE_LIGHT_TYPE) =
+      static_cast<int>(light.type);
+  light_node.append_attribute(ION_SAVE_LIGHT_INTENSITY) = light.intensity;
+  light_node.append_attribute(ION_SAVE_LIGHT_RADIAL_FALLOFF) =
+      light.radial_falloff;
+  light_node.append_attribute(ION_SAVE_LIGHT_VOLUMETRIC_INTENSITY) =
+      light.volumetric_intensity;
+}
+static void WriteScript(pugi::xml_node script_node, const Script &script) {
+  script_node.append_attribute(ION_SAVE_SCRIPT_PATH) = script.path.c_str();
+  script_node.append_attribute(ION_SAVE_SCRIPT_MODULE) =
+      script.module_name.c_str();
+  for (const auto &[name, value] : script.parameters) {
+    auto parameter_node =
+        script_node.append_child(ION_SAVE_SCRIPT_PARAMETER_KEY);
+    parameter_node.append_attribute(ION_SAVE_SCRIPT_PARAMETER_NAME) =
+        name.c_str();
+    parameter_node.append_attribute(ION_SAVE_SCRIPT_PARAMETER_VAL) =
+        value.c_str();
+  }
+}
+
 static void ProcessWorldManifest(std::shared_ptr<World> world) {
   auto path = world->GetWorldPath();
   if (!std::filesystem::exists(path)) {
@@ -45,61 +184,39 @@ static void ProcessWorldManifest(std::shared_ptr<World> world) {
     auto value = marker_node.attribute(ION_SAVE_MARKER_VAL).as_string();
     world->GetMarkers().insert({id, value});
   }
+  for (auto prefab_node : root.children(ION_SAVE_PREFAB_KEY)) {
+    auto name = prefab_node.attribute(ION_SAVE_PREFAB_NAME).as_string();
+    ReadPrefab(prefab_node, world->GetPrefabs()[name]);
+  }
   for (auto component_node : root.children(ION_SAVE_COMPONENT_KEY)) {
     auto type = std::string(
         component_node.attribute(ION_SAVE_COMPONENT_TYPE).as_string());
     auto id = component_node.attribute(ION_SAVE_ENTITY_ID).as_uint();
+    world->RestoreEntity(id);
+    if (!world->IsValid(id)) {
+      continue;
+    }
     if (type == ION_SAVE_TRANSFORM_KEY) {
-      auto transform = world->NewComponent<Transform>(id);
-      auto transform_node = component_node.child(ION_SAVE_TRANSFORM_KEY);
-      transform->position.x =
-          transform_node.attribute(ION_SAVE_TRANSFORM_POS_X).as_float();
-      transform->position.y =
-          transform_node.attribute(ION_SAVE_TRANSFORM_POS_Y).as_float();
-      transform->rotation =
-          transform_node.attribute(ION_SAVE_TRANSFORM_ROTATION)
-              .as_float(transform->rotation);
-      transform->scale.x = transform_node.attribute(ION_SAVE_TRANSFORM_SCALE_X)
-                               .as_float(transform->scale.x);
-      transform->scale.y = transform_node.attribute(ION_SAVE_TRANSFORM_SCALE_Y)
-                               .as_float(transform->scale.y);
+      ReadTransform(component_node.child(ION_SAVE_TRANSFORM_KEY),
+                    *world->NewComponent<Transform>(id));
     } else if (type == ION_SAVE_RENDERABLE_KEY) {
-      auto renderable = world->NewComponent<Renderable>(id);
-      auto renderable_node = component_node.child(ION_SAVE_RENDERABLE_KEY);
-      renderable->color = ion::res::LoadAsset<Texture>(
-          renderable_node.attribute(ION_SAVE_RENDERABLE_COLOR).as_string());
-      renderable->normal = ion::res::LoadAsset<Texture>(
-          renderable_node.attribute(ION_SAVE_RENDERABLE_NORMAL).as_string());
-      renderable->shader = ion::res::LoadAsset<Shader>(
-          renderable_node.attribute(ION_SAVE_RENDERABLE_SHADER).as_string());
-      renderable->data = ion::res::LoadAsset<GPUData>(
-          renderable_node.attribute(ION_SAVE_RENDERABLE_GPU_DATA).as_string());
+      ReadRenderable(component_node.child(ION_SAVE_RENDERABLE_KEY),
+                     *world->NewComponent<Renderable>(id));
     } else if (type == ION_SAVE_PHYSICS_BODY_KEY) {
       auto physics_body = world->NewComponent<PhysicsBody>(id);
       auto physics_node = component_node.child(ION_SAVE_PHYSICS_BODY_KEY);
       physics_body->body_id =
-          ion::physics::CreateBody(world->GetComponent<Transform>(id));
+          ion::physics::CreateBody(*world->GetComponent<Transform>(id));
     } else if (type == ION_SAVE_LIGHT_KEY) {
-      auto light = world->NewComponent<Light>(id);
-      auto light_node = component_node.child(ION_SAVE_LIGHT_KEY);
-      light->type = static_cast<LightType>(
-          light_node.attribute(ION_SAVE_LIGHT_TYPE).as_int());
-      light->intensity = light_node.attribute(ION_SAVE_LIGHT_INTENSITY)
-                             .as_float(light->intensity);
-      light->radial_falloff =
-          light_node.attribute(ION_SAVE_LIGHT_RADIAL_FALLOFF)
-              .as_float(light->radial_falloff);
-      light->volumetric_intensity =
-          light_node.attribute(ION_SAVE_LIGHT_VOLUMETRIC_INTENSITY)
-              .as_float(light->volumetric_intensity);
-      light->color.r =
-          light_node.attribute(ION_SAVE_LIGHT_COLOR_R).as_float(light->color.r);
-      light->color.g =
-          light_node.attribute(ION_SAVE_LIGHT_COLOR_G).as_float(light->color.g);
-      light->color.b =
-          light_node.attribute(ION_SAVE_LIGHT_COLOR_B).as_float(light->color.b);
+      ReadLight(component_node.child(ION_SAVE_LIGHT_KEY),
+                *world->NewComponent<Light>(id));
     } else if (type == ION_SAVE_CAMERA_KEY) {
-      auto camera = world->NewComponent<Camera>(id);
+      world->NewComponent<Camera>(id);
+    } else if (type == ION_SAVE_HIERARCHY_KEY) {
+      world->NewComponent<Hierarchy>(id)->parent =
+          component_node.child(ION_SAVE_HIERARCHY_KEY)
+              .attribute(ION_SAVE_HIERARCHY_PARENT)
+              .as_uint(NULL_ENTITY);
     }
   }
 }
@@ -205,71 +322,51 @@ ION_API void ion::res::SaveAsset(std::filesystem::path path,
     marker_node.append_attribute(ION_SAVE_MARKER_ID) = entity_id;
     marker_node.append_attribute(ION_SAVE_MARKER_VAL) = marker_name.c_str();
   }
-  for (const auto &[entity_id, transform] :
-       asset->GetComponentSet<Transform>()) {
-    auto component_node = root.append_child(ION_SAVE_COMPONENT_KEY);
-    component_node.append_attribute(ION_SAVE_COMPONENT_TYPE) =
-        ION_SAVE_TRANSFORM_KEY;
-    component_node.append_attribute(ION_SAVE_ENTITY_ID) = entity_id;
-    auto transform_node = component_node.append_child(ION_SAVE_TRANSFORM_KEY);
-    transform_node.append_attribute(ION_SAVE_TRANSFORM_POS_X) =
-        transform->position.x;
-    transform_node.append_attribute(ION_SAVE_TRANSFORM_POS_Y) =
-        transform->position.y;
-    transform_node.append_attribute(ION_SAVE_TRANSFORM_ROTATION) =
-        transform->rotation;
-    transform_node.append_attribute(ION_SAVE_TRANSFORM_SCALE_X) =
-        transform->scale.x;
-    transform_node.append_attribute(ION_SAVE_TRANSFORM_SCALE_Y) =
-        transform->scale.y;
-  }
-  for (const auto &[entity_id, renderable] :
-       asset->GetComponentSet<Renderable>()) {
-    auto component_node = root.append_child(ION_SAVE_COMPONENT_KEY);
-    component_node.append_attribute(ION_SAVE_COMPONENT_TYPE) =
-        ION_SAVE_RENDERABLE_KEY;
-    component_node.append_attribute(ION_SAVE_ENTITY_ID) = entity_id;
-    auto renderable_node = component_node.append_child(ION_SAVE_RENDERABLE_KEY);
-    renderable_node.append_attribute(ION_SAVE_RENDERABLE_COLOR) =
-        renderable->color->GetID().c_str();
-    renderable_node.append_attribute(ION_SAVE_RENDERABLE_NORMAL) =
-        renderable->normal->GetID().c_str();
-    renderable_node.append_attribute(ION_SAVE_RENDERABLE_SHADER) =
-        renderable->shader->GetID().c_str();
-    renderable_node.append_attribute(ION_SAVE_RENDERABLE_GPU_DATA) =
-        renderable->data->GetID().c_str();
-  }
-  for (const auto &[entity_id, physics_body] :
+  for (const auto &[name, prefab] : asset->GetPrefabs()) {
+    auto prefab_node = root.append_child(ION_SAVE_PREFAB_KEY);
+    prefab_node.append_attribute(ION_SAVE_PREFAB_NAME) = name.c_str();
+    WriteTransform(AppendComponent(prefab_node, ION_SAVE_TRANSFORM_KEY),
+                   prefab.transform);
+    if (prefab.renderable) {
+      WriteRenderable(AppendComponent(prefab_node, ION_SAVE_RENDERABLE_KEY),
+                      *prefab.renderable);
+    }
+    if (prefab.physics_body) {
+      AppendComponent(prefab_node, ION_SAVE_PHYSICS_BODY_KEY);
+    }
+    if (prefab.light) {
+      WriteLight(AppendComponent(prefab_node, ION_SAVE_LIGHT_KEY),
+                 *prefab.light);
+    }
+    if (prefab.camera) {
+      AppendComponent(prefab_node, ION_SAVE_CAMERA_KEY);
+    }
+    if (prefab.script) {
+      WriteScript(AppendComponent(prefab_node, ION_SAVE_SCRIPT_KEY),
+                  *prefab.script);
+    }
+  }
+  for (auto [entity_id, transform] : asset->GetComponentSet<Transform>()) {
+    WriteTransform(AppendComponent(root, ION_SAVE_TRANSFORM_KEY, entity_id),
+                   transform);
+  }
+  for (auto [entity_id, renderable] : asset->GetComponentSet<Renderable>()) {
+    WriteRenderable(AppendComponent(root, ION_SAVE_RENDERABLE_KEY, entity_id),
+                    renderable);
+  }
+  for (auto [entity_id, physics_body] :
        asset->GetComponentSet<PhysicsBody>()) {
-    auto component_node = root.append_child(ION_SAVE_COMPONENT_KEY);
-    component_node.append_attribute(ION_SAVE_COMPONENT_TYPE) =
-        ION_SAVE_PHYSICS_BODY_KEY;
-    component_node.append_attribute(ION_SAVE_ENTITY_ID) = entity_id;
-    auto physics_node = component_node.append_child(ION_SAVE_PHYSICS_BODY_KEY);
+    AppendComponent(root, ION_SAVE_PHYSICS_BODY_KEY, entity_id);
   }
-  for (const auto &[entity_id, light] : asset->GetComponentSet<Light>()) {
-    auto component_node = root.append_child(ION_SAVE_COMPONENT_KEY);
-    component_node.append_attribute(ION_SAVE_COMPONENT_TYPE) =
-        ION_SAVE_LIGHT_KEY;
-    component_node.append_attribute(ION_SAVE_ENTITY_ID) = entity_id;
-    auto light_node = component_node.append_child(ION_SAVE_LIGHT_KEY);
-    light_node.append_attribute(ION_SAVE_LIGHT_COLOR_R) = light->color.r;
-    light_node.append_attribute(ION_SAVE_LIGHT_COLOR_G) = light->color.g;
-    light_node.append_attribute(ION_SAVE_LIGHT_COLOR_B) = light->color.b;
-    light_node.append_attribute(ION_SAVE_LIGHT_TYPE) =
-        static_cast<int>(light->type);
-    light_node.append_attribute(ION_SAVE_LIGHT_INTENSITY) = light->intensity;
-    light_node.append_attribute(ION_SAVE_LIGHT_RADIAL_FALLOFF) =
-        light->radial_falloff;
-    light_node.append_attribute(ION_SAVE_LIGHT_VOLUMETRIC_INTENSITY) =
-        light->volumetric_intensity;
-  }
-  for (const auto &[entity_id, camera] : asset->GetComponentSet<Camera>()) {
-    auto component_node = root.append_child(ION_SAVE_COMPONENT_KEY);
-    component_node.append_attribute(ION_SAVE_COMPONENT_TYPE) =
-        ION_SAVE_CAMERA_KEY;
-    component_node.append_attribute(ION_SAVE_ENTITY_ID) = entity_id;
-    auto camera_node = component_node.append_child(ION_SAVE_CAMERA_KEY);
+  for (auto [entity_id, light] : asset->GetComponentSet<Light>()) {
+    WriteLight(AppendComponent(root, ION_SAVE_LIGHT_KEY, entity_id), light);
+  }
+  for (auto [entity_id, camera] : asset->GetComponentSet<Camera>()) {
+    AppendComponent(root, ION_SAVE_CAMERA_KEY, entity_id);
+  }
+  for (auto [entity_id, hierarchy] : asset->GetComponentSet<Hierarchy>()) {
+    AppendComponent(root, ION_SAVE_HIERARCHY_KEY, entity_id)
+        .append_attribute(ION_SAVE_HIERARCHY_PARENT) = hierarchy.parent;
   }
   doc.save_file(path.c_str());
 }
@@ -282,6 +379,7 @@ ion::res::LoadAsset<World>(std::filesystem::path path, bool is_hash) {
   }
   auto world = std::make_shared<World>(path);
   ProcessWorldManifest(world);
+  internal::BuildTextureAtlasWhenLoaded(world);
   if (is_hash) {
     internal::worlds.insert({path.filename().string(), world});
   } else {
@@ -300,11 +398,21 @@ ion::res::LoadAsset<Texture>(std::filesystem::path source_path, bool is_hash) {
           std::format("Texture does not exist: {}\n", source_path.string()));
     }
     id = ion::id::GenerateHashFromString(source_path.string());
+  } else {
+    id = source_path.filename().string();
+  }
+  // Renderables sharing an imported image share its texture.
+  if (auto loaded = internal::textures.find(id);
+      is_hash && loaded != internal::textures.end()) {
+    return loaded->second;
+  }
+  if (GetAsyncTextureLoading()) {
+    return internal::LoadTextureAsync(is_hash ? "" : source_path, id);
+  }
+  if (!is_hash) {
     std::filesystem::copy_file(std::filesystem::absolute(source_path),
                                GetProjectRoot() / id,
                                std::filesystem::copy_options::update_existing);
-  } else {
-    id = source_path.filename().string();
   }
 
   std::filesystem::path imported_path = GetProjectRoot() / id;
@@ -346,6 +454,12 @@ ion::res::LoadAsset<Shader>(std::filesystem::path source_path, bool is_hash) {
     std::filesystem::copy_file(source_path / "fs.glsl",
                                shader_directory / "fs.glsl",
                                std::filesystem::copy_options::update_existing);
+    if (std::filesystem::exists(source_path / "vs_instanced.glsl")) {
+      std::filesystem::copy_file(
+          source_path / "vs_instanced.glsl",
+          shader_directory / "vs_instanced.glsl",
+          std::filesystem::copy_options::update_existing);
+    }
   } else {
     id = source_path.filename().string();
   }
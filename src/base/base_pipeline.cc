@@ -1,27 +1,22 @@
 #include "ion/base_pipeline.h"
 #include "ion/assets.h"
+#include "ion/gl_state.h"
 #include "ion/render.h"
+#include "ion/render_graph.h"
 #include "ion/shader.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
 
 BasePipeline::BasePipeline() {
-  color_buffer = ion::render::CreateFramebuffer(
-      FramebufferInfo{.recreate_on_resize = true, .name = "Color"});
-  normal_buffer = ion::render::CreateFramebuffer(
-      FramebufferInfo{.recreate_on_resize = true, .name = "Normal"});
-  shaded = ion::render::CreateFramebuffer(
-      FramebufferInfo{.recreate_on_resize = true, .name = "Shaded"});
-  bloom_buffer = ion::render::CreateFramebuffer(
-      FramebufferInfo{.recreate_on_resize = true, .name = "Bloom"});
-  bloom_buffer_2 = ion::render::CreateFramebuffer(
-      FramebufferInfo{.recreate_on_resize = true, .name = "Bloom 2"});
-  output_buffer = ion::render::CreateFramebuffer(
-		FramebufferInfo{ .recreate_on_resize = true, .name = "Output" });
   deferred_shader =
       ion::res::LoadAsset<Shader>("assets/deferred_shader", false);
   screen_shader = ion::res::LoadAsset<Shader>("assets/screen_shader", false);
   bloom_shader = ion::res::LoadAsset<Shader>("assets/bloom_shader", false);
-  bloom_blur_shader =
-      ion::res::LoadAsset<Shader>("assets/bloom_blur_shader", false);
+  bloom_downsample_shader =
+      ion::res::LoadAsset<Shader>("assets/bloom_downsample_shader", false);
+  bloom_upsample_shader =
+      ion::res::LoadAsset<Shader>("assets/bloom_upsample_shader", false);
   combine_shader =
       ion::res::LoadAsset<Shader>("assets/bloom_combine_shader", false);
   tonemap_shader = ion::res::LoadAsset<Shader>("assets/tonemap_shader", false);
@@ -31,50 +26,187 @@ BasePipeline::BasePipeline() {
 
 void BasePipeline::Render(std::shared_ptr<World> world,
                           const PipelineSettings &settings) {
-  ion::render::BindFramebuffer(color_buffer);
-  ion::render::Clear();
-  ion::render::DrawWorld(world, RENDER_PASS_COLOR);
-  ion::render::BindFramebuffer(normal_buffer);
-  ion::render::Clear();
-  ion::render::DrawWorld(world, RENDER_PASS_NORMAL);
+  auto packet = snapshots.BeginWrite();
+  ion::render::ExtractFrame(world, *packet);
+  snapshots.Publish(packet);
+  Render(*packet, settings);
+}
 
-  ion::render::BindFramebuffer(shaded);
-  ion::render::Clear();
-  ion::render::Render(color_buffer, normal_buffer, screen_data, deferred_shader,
-                      world);
-  ion::render::UnbindFramebuffer();
+namespace {
+struct GeometryPass {
+  RenderResource gbuffer = NULL_RENDER_RESOURCE;
+};
+struct ScreenPass {
+  RenderResource input = NULL_RENDER_RESOURCE;
+  RenderResource output = NULL_RENDER_RESOURCE;
+};
+} // namespace
 
-  if (settings.bloom_enable) {
-    ion::render::BindFramebuffer(bloom_buffer);
-    ion::render::Clear();
-    ion::render::UseShader(bloom_shader);
-    ion::render::RunPass(shaded, bloom_buffer, bloom_shader, screen_data);
+RenderResource BasePipeline::AddBloomPasses(RenderResource scene,
+                                            const PipelineSettings &settings) {
+  auto &threshold = graph.AddPass<ScreenPass>(
+      "Bloom Threshold",
+      [scene](RenderGraph::Builder &builder, ScreenPass &data) {
+        data.input = scene;
+        builder.Read(scene);
+        data.output = builder.Create(
+            FramebufferInfo{.linear_filter = true, .name = "Bloom"});
+      },
+      [this](const ScreenPass &data, const RenderGraph &graph) {
+        ion::render::UseShader(bloom_shader);
+        ion::render::RunPass(graph.Get(data.input), graph.Get(data.output),
+                             bloom_shader, screen_data);
+      });
 
-    ion::render::UseShader(bloom_blur_shader);
-    bool horizontal = true;
+  // Blur by walking down the chain and back up to full resolution. Each
+  // upsample target can reuse the memory of the downsample at its level.
+  // A strength of 0 combines the unblurred threshold, as before.
+  auto levels = 0;
+  if (settings.bloom_strength > 0) {
+    levels = std::clamp(
+        static_cast<int>(std::ceil(std::log2(settings.bloom_strength))) + 1, 1,
+        BLOOM_LEVELS);
+  }
+  std::vector<FramebufferInfo> level_infos;
+  level_infos.push_back(FramebufferInfo{.linear_filter = true, .name = "Bloom"});
+  for (int i = 0; i < levels; i++) {
+    level_infos.push_back(
+        FramebufferInfo{.downscale = 2 << i,
+                        .linear_filter = true,
+                        .name = "Bloom 1/" + std::to_string(2 << i)});
+  }
+  auto blurred = threshold.output;
+  for (int i = 1; i <= levels; i++) {
+    blurred = graph
+                  .AddPass<ScreenPass>(
+                      "Bloom Downsample " + std::to_string(i),
+                      [&](RenderGraph::Builder &builder, ScreenPass &data) {
+                        data.input = blurred;
+                        builder.Read(blurred);
+                        data.output = builder.Create(level_infos[i]);
+                      },
+                      [this](const ScreenPass &data, const RenderGraph &graph) {
+                        ion::render::UseShader(bloom_downsample_shader);
+                        ion::render::RunPass(graph.Get(data.input),
+                                             graph.Get(data.output),
+                                             bloom_downsample_shader,
+                                             screen_data);
+                      })
+                  .output;
+  }
+  for (int i = levels - 1; i >= 0; i--) {
+    blurred = graph
+                  .AddPass<ScreenPass>(
+                      "Bloom Upsample " + std::to_string(i),
+                      [&](RenderGraph::Builder &builder, ScreenPass &data) {
+                        data.input = blurred;
+                        builder.Read(blurred);
+                        data.output = builder.Create(level_infos[i]);
+                      },
+                      [this](const ScreenPass &data, const RenderGraph &graph) {
+                        ion::render::UseShader(bloom_upsample_shader);
+                        ion::render::RunPass(graph.Get(data.input),
+                                             graph.Get(data.output),
+                                             bloom_upsample_shader,
+                                             screen_data);
+                      })
+                  .output;
+  }
 
-    for (int i = 0; i < settings.bloom_strength; i++) {
-      auto &source = horizontal ? bloom_buffer : bloom_buffer_2;
-      auto &target = horizontal ? bloom_buffer_2 : bloom_buffer;
-      ion::render::BindFramebuffer(target);
-      ion::render::Clear();
-      bloom_blur_shader->SetUniform("horizontal", (int)horizontal);
-      ion::render::RunPass(source, target, bloom_blur_shader, screen_data);
-      horizontal = !horizontal;
-    }
+  return graph
+      .AddPass<ScreenPass>(
+          "Bloom Combine",
+          [&](RenderGraph::Builder &builder, ScreenPass &data) {
+            data.input = blurred;
+            builder.Read(blurred);
+            builder.Read(scene);
+            data.output =
+                builder.Create(FramebufferInfo{.name = "Composited"});
+          },
+          [this, scene](const ScreenPass &data, const RenderGraph &graph) {
+            ion::render::UseShader(combine_shader);
+            ion::render::BindTexture(graph.Get(scene), 1);
+            combine_shader->SetUniform("ION_PASS_FRAMEBUFFER", 1);
+            ion::render::RunPass(graph.Get(data.input), graph.Get(data.output),
+                                 combine_shader, screen_data);
+          })
+      .output;
+}
 
-    ion::render::UseShader(combine_shader);
-    ion::render::BindTexture(shaded, 1);
-    combine_shader->SetUniform("ION_PASS_FRAMEBUFFER", 1);
-    ion::render::RunPass(bloom_buffer, shaded, combine_shader, screen_data);
+void BasePipeline::Render(const FramePacket &packet,
+                          const PipelineSettings &settings) {
+  ion::render::ResetDrawStats();
+  ion::render::gl::ResetStats();
+  ion::render::BeginFrame();
+
+  auto &geometry = graph.AddPass<GeometryPass>(
+      "Geometry",
+      [](RenderGraph::Builder &builder, GeometryPass &data) {
+        data.gbuffer = builder.Create(FramebufferInfo{
+            .color_attachments = GBUFFER_COUNT, .name = "G-Buffer"});
+      },
+      [&packet](const GeometryPass &data, const RenderGraph &graph) {
+        ion::render::BindFramebuffer(graph.Get(data.gbuffer));
+        ion::render::Clear();
+        ion::render::DrawWorld(packet);
+      });
+
+  auto &lighting = graph.AddPass<ScreenPass>(
+      "Lighting",
+      [&geometry](RenderGraph::Builder &builder, ScreenPass &data) {
+        data.input = geometry.gbuffer;
+        builder.Read(data.input);
+        data.output = builder.Create(FramebufferInfo{.name = "Shaded"});
+      },
+      [this, &packet](const ScreenPass &data, const RenderGraph &graph) {
+        ion::render::BindFramebuffer(graph.Get(data.output));
+        ion::render::Clear();
+        ion::render::Render(graph.Get(data.input), screen_data,
+                            deferred_shader, packet);
+      });
+
+  auto scene = lighting.output;
+  for (auto &custom_pass : custom_passes) {
+    scene = custom_pass(graph, scene);
+  }
+  if (settings.bloom_enable) {
+    scene = AddBloomPasses(scene, settings);
   }
 
+  auto output = NULL_RENDER_RESOURCE;
   if (settings.render_to_output_buffer) {
-		ion::render::BindFramebuffer(output_buffer);
-    ion::render::Clear();
-    ion::render::DrawFramebuffer(shaded, screen_shader, screen_data, output_buffer);
-  }
-  else {
-    ion::render::DrawFramebuffer(shaded, screen_shader, screen_data);
+    if (!output_buffer) {
+      // Headless output stands in for the window, so it is read back at the
+      // requested size rather than the render resolution.
+      output_buffer = ion::render::CreateFramebuffer(
+          FramebufferInfo{.recreate_on_resize = true,
+                          .window_resolution = ion::render::IsHeadless(),
+                          .name = "Output"});
+    }
+    output = graph.Import(output_buffer);
   }
+  graph.AddPass<ScreenPass>(
+      "Present",
+      [scene, output](RenderGraph::Builder &builder, ScreenPass &data) {
+        data.input = scene;
+        data.output = output;
+        builder.Read(scene);
+        if (output != NULL_RENDER_RESOURCE) {
+          builder.Write(output);
+        } else {
+          builder.SideEffect();
+        }
+      },
+      [this](const ScreenPass &data, const RenderGraph &graph) {
+        if (data.output != NULL_RENDER_RESOURCE) {
+          ion::render::DrawFramebuffer(graph.Get(data.input), screen_shader,
+                                       screen_data, graph.Get(data.output));
+        } else {
+          ion::render::DrawFramebuffer(graph.Get(data.input), screen_shader,
+                                       screen_data);
+        }
+      });
+
+  graph.Execute();
+  ion::render::EndFrame();
 }
@@ -0,0 +1,14 @@
+#include "ion/component_registry.h"
+#include <map>
+#include <mutex>
+
+ComponentTypeID ion::internal::RegisterComponentType(std::type_index type) {
+  // Function-local so registration works during static initialization.
+  static std::map<std::type_index, ComponentTypeID> component_types;
+  // First use of a type can happen on any thread, e.g. during extraction.
+  static std::mutex component_types_mutex;
+  std::lock_guard lock(component_types_mutex);
+  auto [it, inserted] = component_types.try_emplace(
+      type, static_cast<ComponentTypeID>(component_types.size()));
+  return it->second;
+}
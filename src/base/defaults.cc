@@ -4,9 +4,9 @@
 
 Defaults::Defaults() {
   default_color =
-      ion::res::LoadAsset<Texture>("assets/test_sprite/color.png", false),
+      ion::res::LoadAsset<Texture>(ION_DEFAULT_COLOR_TEXTURE, false),
   default_normal =
-      ion::res::LoadAsset<Texture>("assets/test_sprite/normal.png", false),
+      ion::res::LoadAsset<Texture>(ION_DEFAULT_NORMAL_TEXTURE, false),
   default_shader = ion::res::LoadAsset<Shader>("assets/texture_shader", false),
   default_data = ion::res::LoadAsset<GPUData>("assets/default_quad", false);
 }
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "ion/frame_packet.h"
+
+void FramePacket::Clear() {
+  tick = 0;
+  cameras.clear();
+  sprites.clear();
+  culling = CullingStats{};
+  lights.clear();
+  queue.Clear();
+}
+
+std::shared_ptr<FramePacket> FrameSnapshots::BeginWrite() {
+  std::shared_ptr<FramePacket> packet;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    // The spare can no longer be handed out, so a use count of one means the
+    // reader is done with it.
+    if (spare && spare.use_count() == 1) {
+      packet = std::move(spare);
+    }
+  }
+  if (!packet) {
+    packet = std::make_shared<FramePacket>();
+  }
+  packet->Clear();
+  return packet;
+}
+
+void FrameSnapshots::Publish(std::shared_ptr<FramePacket> packet) {
+  std::lock_guard<std::mutex> lock(mutex);
+  spare = std::move(latest);
+  latest = std::move(packet);
+}
+
+std::shared_ptr<const FramePacket> FrameSnapshots::Latest() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return latest;
+}
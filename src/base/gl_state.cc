@@ -0,0 +1,203 @@
+#include "ion/gl_state.h"
+#include <array>
+#include <glad/glad.h>
+#include <utility>
+#include <vector>
+
+namespace {
+// No GL object has this name, so it never matches a real binding.
+constexpr unsigned int UNKNOWN = 0xFFFFFFFF;
+constexpr std::size_t TEXTURE_UNITS = 16;
+
+enum BufferSlot { ARRAY_SLOT, ELEMENT_SLOT, TEXTURE_BUFFER_SLOT, BUFFER_SLOTS };
+enum TextureSlot { TEXTURE_2D_SLOT, TEXTURE_BUFFER_TEXTURE_SLOT, TEXTURE_SLOTS };
+
+struct State {
+  unsigned int program = UNKNOWN;
+  unsigned int vertex_array = UNKNOWN;
+  std::array<unsigned int, BUFFER_SLOTS> buffers;
+  unsigned int active_texture = UNKNOWN;
+  std::array<std::array<unsigned int, TEXTURE_SLOTS>, TEXTURE_UNITS> textures;
+  unsigned int framebuffer = UNKNOWN;
+  std::array<int, 4> viewport = {-1, -1, -1, -1};
+  // (capability, enabled) pairs seen so far.
+  std::vector<std::pair<unsigned int, bool>> capabilities;
+  State() {
+    buffers.fill(UNKNOWN);
+    for (auto &unit : textures) {
+      unit.fill(UNKNOWN);
+    }
+  }
+};
+State state;
+ion::render::gl::StateStats stats;
+
+int GetBufferSlot(unsigned int target) {
+  switch (target) {
+  case GL_ARRAY_BUFFER:
+    return ARRAY_SLOT;
+  case GL_ELEMENT_ARRAY_BUFFER:
+    return ELEMENT_SLOT;
+  case GL_TEXTURE_BUFFER:
+    return TEXTURE_BUFFER_SLOT;
+  default:
+    return -1;
+  }
+}
+
+int GetTextureSlot(unsigned int target) {
+  switch (target) {
+  case GL_TEXTURE_2D:
+    return TEXTURE_2D_SLOT;
+  case GL_TEXTURE_BUFFER:
+    return TEXTURE_BUFFER_TEXTURE_SLOT;
+  default:
+    return -1;
+  }
+}
+
+// Records value into cached; returns false if the call can be skipped.
+template <typename T> bool Update(T &cached, const T &value) {
+  if (cached == value) {
+    stats.skipped++;
+    return false;
+  }
+  cached = value;
+  stats.issued++;
+  return true;
+}
+} // namespace
+
+void ion::render::gl::UseProgram(unsigned int program) {
+  if (Update(state.program, program)) {
+    glUseProgram(program);
+  }
+}
+
+void ion::render::gl::BindVertexArray(unsigned int vertex_array) {
+  if (Update(state.vertex_array, vertex_array)) {
+    glBindVertexArray(vertex_array);
+    state.buffers[ELEMENT_SLOT] = UNKNOWN;
+  }
+}
+
+void ion::render::gl::BindBuffer(unsigned int target, unsigned int buffer) {
+  auto slot = GetBufferSlot(target);
+  if (slot < 0) {
+    stats.issued++;
+    glBindBuffer(target, buffer);
+    return;
+  }
+  if (Update(state.buffers[slot], buffer)) {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void ion::render::gl::ActiveTexture(unsigned int unit) {
+  if (Update(state.active_texture, unit)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+}
+
+void ion::render::gl::BindTexture(unsigned int target, unsigned int texture) {
+  auto slot = GetTextureSlot(target);
+  if (slot < 0 || state.active_texture >= TEXTURE_UNITS) {
+    stats.issued++;
+    glBindTexture(target, texture);
+    if (slot >= 0) {
+      // The active unit is unknown, so nothing can be cached.
+      for (auto &unit : state.textures) {
+        unit[slot] = UNKNOWN;
+      }
+    }
+    return;
+  }
+  if (Update(state.textures[state.active_texture][slot], texture)) {
+    glBindTexture(target, texture);
+  }
+}
+
+void ion::render::gl::BindTextureUnit(unsigned int unit, unsigned int target,
+                                      unsigned int texture) {
+  auto slot = GetTextureSlot(target);
+  if (slot >= 0 && unit < TEXTURE_UNITS &&
+      state.textures[unit][slot] == texture) {
+    stats.skipped++;
+    return;
+  }
+  ActiveTexture(unit);
+  BindTexture(target, texture);
+}
+
+void ion::render::gl::BindFramebuffer(unsigned int framebuffer) {
+  if (Update(state.framebuffer, framebuffer)) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  }
+}
+
+void ion::render::gl::Viewport(int x, int y, int width, int height) {
+  if (Update(state.viewport, std::array<int, 4>{x, y, width, height})) {
+    glViewport(x, y, width, height);
+  }
+}
+
+void ion::render::gl::SetCapability(unsigned int capability, bool enabled) {
+  for (auto &[cached_capability, cached_enabled] : state.capabilities) {
+    if (cached_capability == capability) {
+      if (!Update(cached_enabled, enabled)) {
+        return;
+      }
+      enabled ? glEnable(capability) : glDisable(capability);
+      return;
+    }
+  }
+  state.capabilities.push_back({capability, enabled});
+  stats.issued++;
+  enabled ? glEnable(capability) : glDisable(capability);
+}
+
+void ion::render::gl::DeleteProgram(unsigned int program) {
+  if (state.program == program) {
+    state.program = UNKNOWN;
+  }
+  glDeleteProgram(program);
+}
+
+void ion::render::gl::DeleteVertexArray(unsigned int vertex_array) {
+  if (state.vertex_array == vertex_array) {
+    state.vertex_array = UNKNOWN;
+    state.buffers[ELEMENT_SLOT] = UNKNOWN;
+  }
+  glDeleteVertexArrays(1, &vertex_array);
+}
+
+void ion::render::gl::DeleteBuffer(unsigned int buffer) {
+  for (auto &bound : state.buffers) {
+    if (bound == buffer) {
+      bound = UNKNOWN;
+    }
+  }
+  glDeleteBuffers(1, &buffer);
+}
+
+void ion::render::gl::DeleteTexture(unsigned int texture) {
+  for (auto &unit : state.textures) {
+    for (auto &bound : unit) {
+      if (bound == texture) {
+        bound = UNKNOWN;
+      }
+    }
+  }
+  glDeleteTextures(1, &texture);
+}
+
+void ion::render::gl::DeleteFramebuffer(unsigned int framebuffer) {
+  if (state.framebuffer == framebuffer) {
+    state.framebuffer = UNKNOWN;
+  }
+  glDeleteFramebuffers(1, &framebuffer);
+}
+
+void ion::render::gl::Invalidate() { state = State{}; }
+ion::render::gl::StateStats ion::render::gl::GetStats() { return stats; }
+void ion::render::gl::ResetStats() { stats = StateStats{}; }
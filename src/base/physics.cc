@@ -1,8 +1,11 @@
 #include "ion/physics.h"
 #include <box2d/box2d.h>
+#include <cmath>
+#include <glm/glm.hpp>
 
 namespace ion::physics::internal {
 ION_API b2WorldId world = b2WorldId{};
+ION_API std::uint32_t last_sync_tick = 0;
 } // namespace ion::physics::internal
 
 b2WorldId ion::physics::GetWorld() { return internal::world; }
@@ -13,63 +16,123 @@ void ion::physics::Init() {
   internal::world = b2CreateWorld(&world_def);
 }
 
+// Positions closer than this are treated as equal, which absorbs the rounding
+// of converting between local and world space for parented bodies.
+constexpr float POSITION_TOLERANCE = 1e-4f;
+// Degrees, the unit of Transform::rotation.
+constexpr float ROTATION_TOLERANCE = 1e-3f;
+
+static bool NearlyEqual(glm::vec2 a, b2Vec2 b) {
+  return std::abs(a.x - b.x) <= POSITION_TOLERANCE &&
+         std::abs(a.y - b.y) <= POSITION_TOLERANCE;
+}
+
+static bool NearlyEqualAngle(float a, float b) {
+  return std::abs(std::remainder(a - b, 360.0f)) <= ROTATION_TOLERANCE;
+}
+
+// World rotation of the entity's parent in degrees, 0 without a parent.
+static float GetParentRotation(std::shared_ptr<World> &world,
+                               const TransformCache &world_transforms,
+                               EntityID entity) {
+  auto parent_model = world_transforms.Get(
+      world->GetComponentSet<Transform>(), world->GetParent(entity));
+  return parent_model
+             ? glm::degrees(std::atan2(parent_model->b, parent_model->a))
+             : 0.0f;
+}
+
+static float GetBodyRotation(b2BodyId body) {
+  return glm::degrees(b2Rot_GetAngle(b2Body_GetRotation(body)));
+}
+
 void ion::physics::Update(std::shared_ptr<World> &world) {
-  // Before update. Sync transforms --> physics bodies.
-  for (auto &[entity, physics_body] : world->GetComponentSet<PhysicsBody>()) {
-    if (physics_body->enabled && b2Body_IsValid(physics_body->body_id)) {
-      auto transform = world->GetComponent<Transform>(entity);
-      if (transform) {
-        b2Vec2 body_position = b2Body_GetPosition(physics_body->body_id);
-        float body_rotation =
-            b2Rot_GetAngle(b2Body_GetRotation(physics_body->body_id));
-        if (transform->position.x != body_position.x ||
-            transform->position.y != body_position.y ||
-            transform->rotation != body_rotation) {
-          // Update physics body to match transform
-          b2Body_SetAwake(physics_body->body_id, true);
-          b2Body_SetTransform(
-              physics_body->body_id,
-              b2Vec2(transform->position.x, transform->position.y),
-              b2Body_GetRotation(physics_body->body_id));
-          // Set speed to zero to prevent motion after transform change
-          b2Body_SetLinearVelocity(physics_body->body_id, b2Vec2(0.0, 0.0));
-        }
+  auto &transforms = world->GetComponentSet<Transform>();
+  auto &hierarchies = world->GetComponentSet<Hierarchy>();
+  auto &world_transforms = world->GetWorldTransforms();
+  auto since = internal::last_sync_tick;
+  if (since >= world->GetTick()) {
+    // A different world was loaded since the last update; resync everything.
+    since = 0;
+  }
+  // Before update. Sync transforms edited outside physics --> physics bodies.
+  // Bodies live in world space, so parented entities also resync when an
+  // ancestor moved.
+  for (auto [entity, physics_body, transform] :
+       world->View<PhysicsBody, Transform>()) {
+    if (!physics_body.enabled || !b2Body_IsValid(physics_body.body_id)) {
+      continue;
+    }
+    auto model = world_transforms.Get(transforms, entity);
+    auto moved = transforms.ChangedSince(entity, since) ||
+                 (hierarchies.Contains(entity) &&
+                  world_transforms.versions[transforms.IndexOf(entity)] >
+                      since);
+    if (moved) {
+      auto world_position = glm::vec2(model->tx, model->ty);
+      auto world_rotation =
+          transform.rotation +
+          GetParentRotation(world, world_transforms, entity);
+      b2Vec2 body_position = b2Body_GetPosition(physics_body.body_id);
+      if (!NearlyEqual(world_position, body_position) ||
+          !NearlyEqualAngle(world_rotation,
+                            GetBodyRotation(physics_body.body_id))) {
+        // Update physics body to match transform
+        b2Body_SetAwake(physics_body.body_id, true);
+        b2Body_SetTransform(physics_body.body_id,
+                            b2Vec2(world_position.x, world_position.y),
+                            b2MakeRot(glm::radians(world_rotation)));
+        // Set speed to zero to prevent motion after transform change
+        b2Body_SetLinearVelocity(physics_body.body_id, b2Vec2(0.0, 0.0));
       }
     }
   }
   b2World_Step(internal::world, 1.0f / 60.0f, 4);
-  // After update. Sync physics bodies --> transforms.
-  for (auto &[entity, physics_body] : world->GetComponentSet<PhysicsBody>()) {
-    if (physics_body->enabled && b2Body_IsValid(physics_body->body_id)) {
-      auto transform = world->GetComponent<Transform>(entity);
-      if (transform) {
-        b2Vec2 position = b2Body_GetPosition(physics_body->body_id);
-        transform->position = glm::vec2(position.x, position.y);
-        transform->rotation =
-            b2Rot_GetAngle(b2Body_GetRotation(physics_body->body_id));
-        printf("Entity Physics Update: ID %u, Position (%.2f, %.2f), Rotation "
-               "%.2f\n",
-               entity, transform->position.x, transform->position.y,
-               transform->rotation);
+  // After update. Sync physics bodies --> transforms. Only bodies that moved
+  // are stamped, so unchanged transforms stay clean for other consumers.
+  for (auto [entity, physics_body, transform] :
+       world->View<PhysicsBody, Transform>()) {
+    if (physics_body.enabled && b2Body_IsValid(physics_body.body_id)) {
+      b2Vec2 body_position = b2Body_GetPosition(physics_body.body_id);
+      auto position = glm::vec2(body_position.x, body_position.y);
+      auto rotation = GetBodyRotation(physics_body.body_id) -
+                      GetParentRotation(world, world_transforms, entity);
+      auto parent = world->GetParent(entity);
+      if (auto parent_model = world_transforms.Get(transforms, parent)) {
+        position = parent_model->Inverse().TransformPoint(position);
+      }
+      if (transform.position == position &&
+          NearlyEqualAngle(transform.rotation, rotation)) {
+        continue;
       }
+      transform.position = position;
+      transform.rotation = rotation;
+      transforms.MarkChanged(entity);
+      printf("Entity Physics Update: ID %u, Position (%.2f, %.2f), Rotation "
+             "%.2f\n",
+             entity, transform.position.x, transform.position.y,
+             transform.rotation);
     }
-    if (physics_body->enabled && !b2Body_IsAwake(physics_body->body_id)) {
-      b2Body_SetAwake(physics_body->body_id, true);
+  }
+  for (auto [entity, physics_body] : world->View<PhysicsBody>()) {
+    if (physics_body.enabled && !b2Body_IsAwake(physics_body.body_id)) {
+      b2Body_SetAwake(physics_body.body_id, true);
     }
-    if (physics_body->enabled == false &&
-        b2Body_IsAwake(physics_body->body_id)) {
-      b2Body_SetAwake(physics_body->body_id, false);
+    if (physics_body.enabled == false &&
+        b2Body_IsAwake(physics_body.body_id)) {
+      b2Body_SetAwake(physics_body.body_id, false);
     }
   }
+  internal::last_sync_tick = world->AdvanceTick();
 }
 
-b2BodyId ion::physics::CreateBody(const std::shared_ptr<Transform> &transform) {
+b2BodyId ion::physics::CreateBody(const Transform &transform) {
   b2BodyDef body_def = b2DefaultBodyDef();
   body_def.type = b2_dynamicBody;
-  body_def.position = b2Vec2(transform->position.x, transform->position.y);
+  body_def.position = b2Vec2(transform.position.x, transform.position.y);
   b2BodyId body = b2CreateBody(internal::world, &body_def);
   b2Polygon shape =
-      b2MakeBox(transform->scale.x * 0.5F, transform->scale.y * 0.5F);
+      b2MakeBox(transform.scale.x * 0.5F, transform.scale.y * 0.5F);
   b2ShapeDef shape_def = b2DefaultShapeDef();
   shape_def.density = 1.0F;
   shape_def.material.friction = 0.3F;
@@ -3,9 +3,13 @@
 // end
 #include "ion/component.h"
 #include "ion/error_code.h"
+#include "ion/gl_state.h"
 #include "ion/render.h"
 #include "ion/shader.h"
+#include "ion/stream_buffer.h"
 #include "ion/texture.h"
+#include "ion/texture_atlas.h"
+#include "ion/texture_loader.h"
 #include "ion/world.h"
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -14,7 +18,17 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <fstream>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 
 namespace ion::render::internal {
 ION_API GLFWwindow *window = nullptr;
@@ -27,24 +41,132 @@ public:
   int render_scale = 4;
   float camera_z = 3.0f;
   glm::vec3 clear_color = glm::vec3(0.0f, 0.0f, 0.0f);
+  float ortho_scale = 10.0f;
+  bool spatial_culling = true;
+  bool headless = false;
+  DynamicResolution dynamic_resolution;
+  float resolution_scale = 1.0f;
 };
 static RenderConfig r_config;
+namespace gl = ion::render::gl;
+
+// Instanced sprite attributes, matching vs_instanced.glsl.
+constexpr unsigned int INSTANCE_BASIS_LOCATION = 2;
+constexpr unsigned int INSTANCE_TRANSLATION_LOCATION = 3;
+constexpr unsigned int INSTANCE_UV_RECT_LOCATION = 4;
+// Bytes per instance: the model, then in a second array the uv rect.
+constexpr std::size_t INSTANCE_SIZE = sizeof(Affine2D) + sizeof(glm::vec4);
+static StreamBuffer stream_buffer;
+// Per-instance data streamed by DrawWorld, read by DrawBatch from
+// instance_source: models at instance_base, uv rects at instance_uv_base.
+// instance_buffer is only used when the stream buffer cannot take them.
+static unsigned int instance_source = 0;
+static std::size_t instance_base = 0;
+static std::size_t instance_uv_base = 0;
+static unsigned int instance_buffer = 0;
+static std::size_t instance_capacity = 0;
+static std::vector<Affine2D> instances;
+static std::vector<glm::vec4> instance_uv_rects;
+static DrawStats draw_stats;
+
+// Uniforms set per draw, hashed at compile time.
+constexpr UniformID VIEW_UNIFORM{"view"};
+constexpr UniformID PROJECTION_UNIFORM{"projection"};
+constexpr UniformID MODEL_UNIFORM{"model"};
+constexpr UniformID UV_RECT_UNIFORM{"uv_rect"};
+constexpr UniformID LAYER_UNIFORM{"layer"};
+constexpr UniformID SAMPLE_UNIFORM{"sample"};
+constexpr UniformID NORMAL_SAMPLE_UNIFORM{"normal_sample"};
+constexpr UniformID LIGHT_DATA_UNIFORM{"light_data"};
+constexpr UniformID LIGHT_TILES_UNIFORM{"light_tiles"};
+constexpr UniformID LIGHT_INDICES_UNIFORM{"light_indices"};
+constexpr UniformID GLOBAL_LIGHT_COUNT_UNIFORM{"global_light_count"};
+constexpr UniformID LIGHT_TILE_SIZE_UNIFORM{"light_tile_size"};
+constexpr UniformID LIGHT_TILES_X_UNIFORM{"light_tiles_x"};
+constexpr UniformID UV_SCALE_UNIFORM{"ION_UV_SCALE"};
+
+// Timestamp pairs around each frame's GPU work, read back a few frames later
+// so the CPU never waits on a result.
+constexpr int GPU_TIMER_FRAMES = 4;
+// Fraction of the way to the scale that would hit the budget taken per
+// measurement, and the smallest step worth taking.
+constexpr float RESOLUTION_RESPONSE = 0.25f;
+constexpr float RESOLUTION_DEADBAND = 0.01f;
+constexpr float MIN_RESOLUTION_SCALE = 0.1f;
+
+// Timed frames kept for WriteTimingsCSV.
+constexpr std::size_t TIMING_HISTORY_FRAMES = 600;
+
+struct PassTimer {
+  std::string name;
+  unsigned int query = 0;
+};
+struct FrameTimer {
+  unsigned int begin = 0;
+  unsigned int end = 0;
+  std::uint64_t frame = 0;
+  // Resolution scale the frame was drawn at.
+  float scale = 1.0f;
+  bool pending = false;
+  // Query objects are kept across frames; the first pass_count are in use.
+  std::vector<PassTimer> passes;
+  std::size_t pass_count = 0;
+};
+struct TimedFrame {
+  std::uint64_t frame = 0;
+  float gpu_ms = 0.0f;
+  std::vector<PassTiming> passes;
+};
+static std::array<FrameTimer, GPU_TIMER_FRAMES> frame_timers;
+static int frame_timer_index = 0;
+static std::uint64_t frame_count = 0;
+static FrameTiming frame_timing;
+static std::vector<PassTiming> pass_timings;
+static std::deque<TimedFrame> timing_history;
+static double last_present = 0.0;
+
+// Lights are uploaded once per frame into texture buffers and point lights
+// are binned into screen tiles, so each fragment of the deferred pass only
+// evaluates the lights that reach it.
+constexpr int LIGHT_TILE_SIZE = 16;
+constexpr int LIGHT_TEXELS = 3;
+// Contributions below this are treated as zero when bounding a light's reach.
+constexpr float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+struct TextureBuffer {
+  unsigned int buffer = 0;
+  unsigned int texture = 0;
+};
+static TextureBuffer light_data;
+static TextureBuffer light_tiles;
+static TextureBuffer light_indices;
+static std::vector<glm::vec4> light_texels;
+// (first index, count) pairs, one per tile.
+static std::vector<std::uint32_t> tile_ranges;
+static std::vector<std::uint32_t> tile_indices;
+
+// Point light with a finite reach, in texture coordinates of the target.
+struct BinnedLight {
+  glm::vec2 center;
+  float radius;
+  std::uint32_t index;
+};
+static std::vector<BinnedLight> binned_lights;
 
 static void SizeCallback(GLFWwindow *window, int w, int h) {
   r_config.window_size.x = w;
   r_config.window_size.y = h;
   ion::render::UpdateFramebuffers();
 }
-static glm::mat4 GetModelFromTransform(std::shared_ptr<Transform> transform) {
-  auto model = glm::mat4(1.0f);
-  model =
-      glm::translate(model, glm::vec3(transform->position.x,
-                                      transform->position.y, transform->layer));
-  model = glm::rotate(model, glm::radians(transform->rotation),
-                      glm::vec3(0.0f, 0.0f, 1.0f));
-  model =
-      glm::scale(model, glm::vec3(transform->scale.x, transform->scale.y, 1));
-  return model;
+// Half size of the orthographic view volume.
+static glm::vec2 GetViewExtent() {
+  return glm::vec2(r_config.ortho_scale * (r_config.window_size.x /
+                                           r_config.window_size.y),
+                   r_config.ortho_scale);
+}
+static glm::mat4 GetProjection() {
+  auto extent = GetViewExtent();
+  return glm::ortho(-extent.x, extent.x, -extent.y, extent.y, 0.1f, 100.0f);
 }
 static GLenum GetTypeEnum(DataType type) {
   switch (type) {
@@ -59,31 +181,76 @@ static GLenum GetTypeEnum(DataType type) {
   }
 }
 
-int ion::render::Init() {
-  glfwInit();
+static int CreateContext() {
+  if (!glfwInit()) {
+    printf("%d\n", WINDOW_CREATE_FAIL);
+    return -1;
+  }
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 #ifdef __APPLE__
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
-  internal::window = glfwCreateWindow(
+  if (r_config.headless) {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    // A surfaceless EGL context needs neither a display nor a window system.
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+  }
+  ion::render::internal::window = glfwCreateWindow(
       r_config.window_size.x, r_config.window_size.y, "ion", NULL, NULL);
-  if (!internal::window) {
+#ifdef GLFW_OSMESA_CONTEXT_API
+  // No EGL driver: fall back to Mesa's software rasterizer.
+  if (!ion::render::internal::window && r_config.headless) {
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    ion::render::internal::window = glfwCreateWindow(
+        r_config.window_size.x, r_config.window_size.y, "ion", NULL, NULL);
+  }
+#endif
+  // Without the null platform, a hidden window with a native context.
+  if (!ion::render::internal::window && r_config.headless) {
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_NATIVE_CONTEXT_API);
+    ion::render::internal::window = glfwCreateWindow(
+        r_config.window_size.x, r_config.window_size.y, "ion", NULL, NULL);
+  }
+  if (!ion::render::internal::window) {
     printf("%d\n", WINDOW_CREATE_FAIL);
     glfwTerminate();
     return -1;
   }
-  glfwMakeContextCurrent(internal::window);
+  glfwMakeContextCurrent(ion::render::internal::window);
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
     printf("%d\n", OPENGL_LOADER_FAIL);
     return -1;
   }
-  glEnable(GL_DEPTH_TEST);
-  glDisable(GL_BLEND);
+  gl::SetCapability(GL_DEPTH_TEST, true);
+  gl::SetCapability(GL_BLEND, false);
+  return 0;
+}
+
+int ion::render::Init() {
+  if (CreateContext() != 0) {
+    return -1;
+  }
   glfwSetFramebufferSizeCallback(internal::window, SizeCallback);
   return 0;
 }
+int ion::render::InitHeadless(glm::ivec2 size) {
+  r_config.headless = true;
+  r_config.window_size = glm::vec2(glm::max(size, glm::ivec2(1)));
+#ifdef GLFW_PLATFORM_NULL
+  // The null platform needs no display; its contexts come from EGL
+  // (surfaceless) or OSMesa.
+  glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+  if (CreateContext() != 0) {
+    return -1;
+  }
+  // Nothing is displayed, so frames should not wait for a vertical sync.
+  glfwSwapInterval(0);
+  return 0;
+}
+bool ion::render::IsHeadless() { return r_config.headless; }
 GLFWwindow *ion::render::GetWindow() { return internal::window; }
 glm::vec2 ion::render::GetWindowSize() { return r_config.window_size; }
 int ion::render::GetRenderScale() { return r_config.render_scale; }
@@ -95,7 +262,128 @@ glm::vec3 ion::render::GetClearColor() { return r_config.clear_color; }
 void ion::render::SetClearColor(glm::vec3 color) {
   r_config.clear_color = color;
 }
+bool ion::render::GetSpatialCulling() { return r_config.spatial_culling; }
+void ion::render::SetSpatialCulling(bool enabled) {
+  r_config.spatial_culling = enabled;
+}
+DynamicResolution ion::render::GetDynamicResolution() {
+  return r_config.dynamic_resolution;
+}
+void ion::render::SetDynamicResolution(const DynamicResolution &settings) {
+  r_config.dynamic_resolution = settings;
+}
+float ion::render::GetResolutionScale() { return r_config.resolution_scale; }
+FrameTiming ion::render::GetFrameTiming() { return frame_timing; }
+
+// Moves the resolution scale toward the one that would have drawn a frame
+// measured at scale in the target time. GPU cost follows the pixel count,
+// which goes with the square of the scale.
+static void UpdateResolutionScale(float measured_scale, float gpu_ms) {
+  const auto &settings = r_config.dynamic_resolution;
+  auto min_scale = std::clamp(settings.min_scale, MIN_RESOLUTION_SCALE, 1.0f);
+  auto max_scale = std::clamp(settings.max_scale, min_scale, 1.0f);
+  auto scale = r_config.resolution_scale;
+  if (gpu_ms > 0.0f) {
+    auto desired = measured_scale * std::sqrt(settings.target_ms / gpu_ms);
+    auto step = (desired - scale) * RESOLUTION_RESPONSE;
+    if (std::abs(step) >= RESOLUTION_DEADBAND) {
+      scale += step;
+    }
+  }
+  r_config.resolution_scale = std::clamp(scale, min_scale, max_scale);
+}
+
+void ion::render::BeginFrame() {
+  auto &timer = frame_timers[frame_timer_index];
+  if (timer.begin == 0) {
+    glGenQueries(1, &timer.begin);
+    glGenQueries(1, &timer.end);
+  }
+  if (timer.pending) {
+    GLint available = 0;
+    glGetQueryObjectiv(timer.end, GL_QUERY_RESULT_AVAILABLE, &available);
+    // A result still in flight after GPU_TIMER_FRAMES frames is dropped.
+    if (available) {
+      GLuint64 begin = 0, end = 0;
+      glGetQueryObjectui64v(timer.begin, GL_QUERY_RESULT, &begin);
+      glGetQueryObjectui64v(timer.end, GL_QUERY_RESULT, &end);
+      frame_timing.gpu_ms = static_cast<float>(end - begin) / 1.0e6f;
+      pass_timings.clear();
+      for (std::size_t i = 0; i < timer.pass_count; i++) {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(timer.passes[i].query, GL_QUERY_RESULT,
+                              &elapsed);
+        pass_timings.push_back({timer.passes[i].name,
+                                static_cast<float>(elapsed) / 1.0e6f});
+      }
+      timing_history.push_back({timer.frame, frame_timing.gpu_ms,
+                                pass_timings});
+      if (timing_history.size() > TIMING_HISTORY_FRAMES) {
+        timing_history.pop_front();
+      }
+      if (r_config.dynamic_resolution.enabled) {
+        UpdateResolutionScale(timer.scale, frame_timing.gpu_ms);
+      }
+    }
+    timer.pending = false;
+  }
+  if (!r_config.dynamic_resolution.enabled) {
+    r_config.resolution_scale = 1.0f;
+  }
+  timer.scale = r_config.resolution_scale;
+  timer.frame = frame_count;
+  timer.pass_count = 0;
+  glQueryCounter(timer.begin, GL_TIMESTAMP);
+  stream_buffer.BeginFrame();
+}
+void ion::render::EndFrame() {
+  stream_buffer.EndFrame();
+  auto &timer = frame_timers[frame_timer_index];
+  glQueryCounter(timer.end, GL_TIMESTAMP);
+  timer.pending = true;
+  frame_timer_index = (frame_timer_index + 1) % GPU_TIMER_FRAMES;
+  frame_count++;
+}
+StreamBuffer &ion::render::GetStreamBuffer() { return stream_buffer; }
+void ion::render::BeginPassTimer(const std::string &name) {
+  auto &timer = frame_timers[frame_timer_index];
+  if (timer.pass_count == timer.passes.size()) {
+    glGenQueries(1, &timer.passes.emplace_back().query);
+  }
+  auto &pass = timer.passes[timer.pass_count++];
+  pass.name = name;
+  glBeginQuery(GL_TIME_ELAPSED, pass.query);
+}
+void ion::render::EndPassTimer() { glEndQuery(GL_TIME_ELAPSED); }
+const std::vector<PassTiming> &ion::render::GetPassTimings() {
+  return pass_timings;
+}
+int ion::render::WriteTimingsCSV(const std::string &path) {
+  std::ofstream file(path);
+  if (!file) {
+    printf("%d\n", FILE_WRITE_FAIL);
+    return -1;
+  }
+  file << "frame,pass,gpu_ms\n";
+  for (const auto &timed : timing_history) {
+    file << timed.frame << ",Frame," << timed.gpu_ms << "\n";
+    for (const auto &pass : timed.passes) {
+      file << timed.frame << "," << pass.name << "," << pass.gpu_ms << "\n";
+    }
+  }
+  return 0;
+}
 
+// Points the bound vertex array at the bound GL_ARRAY_BUFFER as described.
+static void SetVertexAttributes(const DataDescriptor &desc) {
+  for (int i = 0; i < desc.pointers.size(); i++) {
+    auto &pointer_data = desc.pointers[i];
+    glVertexAttribPointer(i, pointer_data.size, GetTypeEnum(pointer_data.type),
+                          pointer_data.normalized, pointer_data.stride,
+                          pointer_data.pointer);
+    glEnableVertexAttribArray(i);
+  }
+}
 void ion::render::ConfigureData(std::shared_ptr<GPUData> gpu_data) {
   auto desc = gpu_data->GetDescriptor();
   gpu_data->element_enabled = desc.element_enabled;
@@ -104,49 +392,51 @@ void ion::render::ConfigureData(std::shared_ptr<GPUData> gpu_data) {
   if (gpu_data->element_enabled) {
     glGenBuffers(1, &gpu_data->element_buffer);
   }
-  glBindVertexArray(gpu_data->vertex_attrib);
-  glBindBuffer(GL_ARRAY_BUFFER, gpu_data->vertex_buffer);
+  gl::BindVertexArray(gpu_data->vertex_attrib);
+  gl::BindBuffer(GL_ARRAY_BUFFER, gpu_data->vertex_buffer);
   glBufferData(GL_ARRAY_BUFFER, sizeof(float) * desc.vertices.size(),
                desc.vertices.data(), GL_STATIC_DRAW);
   if (gpu_data->element_enabled) {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu_data->element_buffer);
+    gl::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu_data->element_buffer);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER,
                  sizeof(unsigned int) * desc.indices.size(),
                  desc.indices.data(), GL_STATIC_DRAW);
   }
-  for (int i = 0; i < desc.pointers.size(); i++) {
-    auto &pointer_data = desc.pointers[i];
-    glVertexAttribPointer(i, pointer_data.size, GetTypeEnum(pointer_data.type),
-                          pointer_data.normalized, pointer_data.stride,
-                          pointer_data.pointer);
-    glEnableVertexAttribArray(i);
+  SetVertexAttributes(desc);
+  glGenVertexArrays(1, &gpu_data->instance_attrib);
+  gl::BindVertexArray(gpu_data->instance_attrib);
+  if (gpu_data->element_enabled) {
+    gl::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu_data->element_buffer);
   }
+  SetVertexAttributes(desc);
   UnbindData();
 }
 void ion::render::DestroyData(std::shared_ptr<GPUData> data) {
-  glDeleteVertexArrays(1, &data->vertex_attrib);
-  glDeleteBuffers(1, &data->vertex_buffer);
+  gl::DeleteVertexArray(data->vertex_attrib);
+  gl::DeleteVertexArray(data->instance_attrib);
+  gl::DeleteBuffer(data->vertex_buffer);
   if (data->element_enabled) {
-    glDeleteBuffers(1, &data->element_buffer);
+    gl::DeleteBuffer(data->element_buffer);
   }
 }
+// The element buffer is part of the vertex array state recorded by
+// ConfigureData, so binding the vertex array is enough.
+static void BindGPUData(const GPUData &data) {
+  gl::BindVertexArray(data.vertex_attrib);
+  gl::BindBuffer(GL_ARRAY_BUFFER, data.vertex_buffer);
+}
 void ion::render::BindData(std::shared_ptr<GPUData> data) {
-  glBindVertexArray(data->vertex_attrib);
-  glBindBuffer(GL_ARRAY_BUFFER, data->vertex_buffer);
-  if (data->element_enabled) {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data->element_buffer);
-  }
+  BindGPUData(*data);
 }
 void ion::render::UnbindData() {
-  glBindVertexArray(0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  gl::BindVertexArray(0);
+  gl::BindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 unsigned int ion::render::ConfigureTexture(const TextureInfo &texture_info) {
   unsigned int texture;
   glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
+  gl::BindTexture(GL_TEXTURE_2D, texture);
   if (texture_info.data) {
     GLenum format;
     switch (texture_info.nr_channels) {
@@ -181,82 +471,126 @@ unsigned int ion::render::ConfigureTexture(const TextureInfo &texture_info) {
   return texture;
 }
 
+// Render resolution, or the window's for window_resolution targets, divided
+// by the framebuffer's downscale, at least 1x1.
+static glm::ivec2 GetFramebufferSize(const Framebuffer &framebuffer) {
+  auto scale = framebuffer.window_resolution ? 1 : r_config.render_scale;
+  auto width = static_cast<int>(r_config.window_size.x) / scale;
+  auto height = static_cast<int>(r_config.window_size.y) / scale;
+  return glm::ivec2(std::max(width / framebuffer.downscale, 1),
+                    std::max(height / framebuffer.downscale, 1));
+}
+
+// Area drawn this frame: the whole target, or its dynamic resolution sub-rect.
+static glm::ivec2 GetViewportSize(const Framebuffer &framebuffer) {
+  auto size = GetFramebufferSize(framebuffer);
+  if (!framebuffer.dynamic_resolution) {
+    return size;
+  }
+  auto scaled = glm::vec2(size) * r_config.resolution_scale;
+  return glm::max(glm::ivec2(scaled), glm::ivec2(1));
+}
+// Texture coordinate of the far corner of the drawn area.
+static glm::vec2 GetUVScale(const Framebuffer &framebuffer) {
+  return glm::vec2(GetViewportSize(framebuffer)) /
+         glm::vec2(GetFramebufferSize(framebuffer));
+}
+
+// (Re)allocates a color attachment at the framebuffer's current size.
+static void AllocateColorbuffer(const Framebuffer &framebuffer,
+                                unsigned int texture) {
+  auto size = GetFramebufferSize(framebuffer);
+  gl::BindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, size.x, size.y, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, nullptr);
+}
+
 std::shared_ptr<Framebuffer>
 ion::render::CreateFramebuffer(const FramebufferInfo &info) {
   auto framebuffer = std::make_shared<Framebuffer>();
   framebuffer->recreate_on_resize = info.recreate_on_resize;
+  framebuffer->dynamic_resolution = info.dynamic_resolution;
+  framebuffer->window_resolution = info.window_resolution;
+  framebuffer->downscale = std::max(info.downscale, 1);
   glGenFramebuffers(1, &framebuffer->framebuffer);
-  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->framebuffer);
-  glGenTextures(1, &framebuffer->colorbuffer);
-  glBindTexture(GL_TEXTURE_2D, framebuffer->colorbuffer);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F,
-               static_cast<int>(r_config.window_size.x) / r_config.render_scale,
-               static_cast<int>(r_config.window_size.y) / r_config.render_scale,
-               0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         framebuffer->colorbuffer, 0);
+  gl::BindFramebuffer(framebuffer->framebuffer);
+  auto count = std::max(info.color_attachments, 1);
+  framebuffer->colorbuffers.resize(count);
+  glGenTextures(count, framebuffer->colorbuffers.data());
+  std::vector<GLenum> draw_buffers;
+  for (int i = 0; i < count; i++) {
+    auto texture = framebuffer->colorbuffers[i];
+    AllocateColorbuffer(*framebuffer, texture);
+    auto filter = info.linear_filter ? GL_LINEAR : GL_NEAREST;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
+                           GL_TEXTURE_2D, texture, 0);
+    draw_buffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+  }
+  glDrawBuffers(count, draw_buffers.data());
+  framebuffer->colorbuffer = framebuffer->colorbuffers.front();
   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
     printf("Failed to create framebuffer\n");
   }
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  gl::BindFramebuffer(0);
   internal::framebuffers.insert({framebuffer, info.name});
   return framebuffer;
 }
 void ion::render::UpdateFramebuffers() {
   for (auto &[framebuffer, name] : internal::framebuffers) {
     if (framebuffer->recreate_on_resize) {
-      glBindTexture(GL_TEXTURE_2D, framebuffer->colorbuffer);
-      glTexImage2D(
-          GL_TEXTURE_2D, 0, GL_RGBA16F,
-          static_cast<int>(r_config.window_size.x) / r_config.render_scale,
-          static_cast<int>(r_config.window_size.y) / r_config.render_scale, 0,
-          GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-      glBindTexture(GL_TEXTURE_2D, 0);
+      for (auto texture : framebuffer->colorbuffers) {
+        AllocateColorbuffer(*framebuffer, texture);
+      }
     }
   }
 }
+static void DeleteFramebufferObjects(const Framebuffer &framebuffer) {
+  gl::DeleteFramebuffer(framebuffer.framebuffer);
+  for (auto texture : framebuffer.colorbuffers) {
+    gl::DeleteTexture(texture);
+  }
+}
+void ion::render::DestroyFramebuffer(std::shared_ptr<Framebuffer> framebuffer) {
+  DeleteFramebufferObjects(*framebuffer);
+  internal::framebuffers.erase(framebuffer);
+}
 void ion::render::BindFramebuffer(std::shared_ptr<Framebuffer> framebuffer) {
-  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->framebuffer);
-  glViewport(0, 0,
-             static_cast<int>(r_config.window_size.x) / r_config.render_scale,
-             static_cast<int>(r_config.window_size.y) / r_config.render_scale);
+  auto size = GetViewportSize(*framebuffer);
+  gl::BindFramebuffer(framebuffer->framebuffer);
+  gl::Viewport(0, 0, size.x, size.y);
 }
-void ion::render::UnbindFramebuffer() { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
+void ion::render::UnbindFramebuffer() { gl::BindFramebuffer(0); }
 void ion::render::DrawFramebuffer(std::shared_ptr<Framebuffer> framebuffer,
                                   std::shared_ptr<Shader> shader,
                                   std::shared_ptr<GPUData> quad,
                                   std::shared_ptr<Framebuffer> final_buffer) {
   if  (final_buffer) {
-    glBindFramebuffer(GL_FRAMEBUFFER, final_buffer->framebuffer);
-    glViewport(0, 0,
-               static_cast<int>(r_config.window_size.x) / r_config.render_scale,
-               static_cast<int>(r_config.window_size.y) /
-                   r_config.render_scale);
+    auto size = GetFramebufferSize(*final_buffer);
+    gl::BindFramebuffer(final_buffer->framebuffer);
+    gl::Viewport(0, 0, size.x, size.y);
   }
   else {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, static_cast<int>(r_config.window_size.x),
+    gl::BindFramebuffer(0);
+    gl::Viewport(0, 0, static_cast<int>(r_config.window_size.x),
       static_cast<int>(r_config.window_size.y));
   }  
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glDisable(GL_DEPTH_TEST);
+  gl::SetCapability(GL_DEPTH_TEST, false);
   shader->Use();
   BindData(quad);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, framebuffer->colorbuffer);
+  gl::BindTextureUnit(0, GL_TEXTURE_2D, framebuffer->colorbuffer);
   shader->SetUniform("screen_texture", 0);
+  shader->SetUniform(UV_SCALE_UNIFORM, GetUVScale(*framebuffer));
   if (quad->element_enabled) {
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
   } else {
     glDrawArrays(GL_TRIANGLES, 0, 6);
   }
-  glEnable(GL_DEPTH_TEST);
-  UnbindData();
+  gl::SetCapability(GL_DEPTH_TEST, true);
 }
 const std::map<std::shared_ptr<Framebuffer>, std::string> &
 ion::render::GetFramebuffers() {
@@ -264,68 +598,339 @@ ion::render::GetFramebuffers() {
 }
 
 void ion::render::BindTexture(std::shared_ptr<Texture> texture, int slot) {
-  glActiveTexture(GL_TEXTURE0 + slot);
-  glBindTexture(GL_TEXTURE_2D, texture->texture);
+  gl::BindTextureUnit(slot, GL_TEXTURE_2D, texture->texture);
 }
 void ion::render::BindTexture(std::shared_ptr<Framebuffer> framebuffer,
-                              int slot) {
-  glActiveTexture(GL_TEXTURE0 + slot);
-  glBindTexture(GL_TEXTURE_2D, framebuffer->colorbuffer);
+                              int slot, int attachment) {
+  gl::BindTextureUnit(slot, GL_TEXTURE_2D,
+                      framebuffer->colorbuffers[attachment]);
 }
 
 void ion::render::UseShader(std::shared_ptr<Shader> shader) {
-  glUseProgram(shader->GetProgram());
+  shader->Use();
 }
 void ion::render::DestroyShader(std::shared_ptr<Shader> shader) {
-  glDeleteProgram(shader->GetProgram());
+  gl::DeleteProgram(shader->GetProgram());
+  if (shader->HasInstancedVariant()) {
+    gl::DeleteProgram(shader->GetInstancedProgram());
+  }
   shader.reset();
 }
 
-void ion::render::DrawWorld(std::shared_ptr<World> world, RenderPass pass) {
-  for (auto &[entity_id, camera] : world->GetComponentSet<Camera>()) {
-    glm::mat4 view =
-        GetModelFromTransform(world->GetComponent<Transform>(entity_id));
-    view = glm::translate(view, glm::vec3{0.0, 0.0, -3.0});
-    float ortho_scale = 10.0f;
-    auto projection = glm::ortho(
-        -ortho_scale *
-            (ion::render::GetWindowSize().x / ion::render::GetWindowSize().y),
-        ortho_scale *
-            (ion::render::GetWindowSize().x / ion::render::GetWindowSize().y),
-        -ortho_scale, ortho_scale, 0.1f, 100.0f);
-    for (auto &[entity_id, transform] : world->GetComponentSet<Transform>()) {
-      auto renderable = world->GetComponent<Renderable>(entity_id);
-      if (renderable) {
-        if (!renderable->shader || !renderable->data || !renderable->color ||
-            !renderable->normal) {
-          continue;
-        }
-        BindData(renderable->data);
-        renderable->shader->Use();
-        renderable->shader->SetUniform("layer", transform->layer);
-        renderable->shader->SetUniform("view", view);
-        renderable->shader->SetUniform("projection", projection);
-        renderable->shader->SetUniform("model",
-                                       GetModelFromTransform(transform));
-        glActiveTexture(GL_TEXTURE0);
-        if (pass == RENDER_PASS_COLOR) {
-          glBindTexture(GL_TEXTURE_2D, renderable->color->texture);
-        } else if (pass == RENDER_PASS_NORMAL) {
-          glBindTexture(GL_TEXTURE_2D, renderable->normal->texture);
-        }
-        renderable->shader->SetUniform("sample", 0);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        UnbindData();
+// Entities with a renderable inside the camera's world-space view rectangle,
+// in renderable storage order so draw order does not depend on the query.
+// visible is scratch space for the per-transform culling results.
+static void FindVisible(std::shared_ptr<World> &world, const AABB &view,
+                        std::vector<std::uint8_t> &visible,
+                        std::vector<EntityID> &out) {
+  auto &transforms = world->GetComponentSet<Transform>();
+  auto &renderables = world->GetComponentSet<Renderable>();
+  out.clear();
+  if (r_config.spatial_culling) {
+    world->GetSpatialIndex().QueryAABB(view, out);
+    std::erase_if(out, [&renderables](EntityID entity) {
+      return !renderables.Contains(entity);
+    });
+    std::sort(out.begin(), out.end(),
+              [&renderables](EntityID a, EntityID b) {
+                return renderables.IndexOf(a) < renderables.IndexOf(b);
+              });
+    return;
+  }
+  auto &models = world->GetWorldTransforms().models;
+  visible.resize(models.size());
+  ion::render::CullModels(models.data(), models.size(), view.min, view.max,
+                          visible.data());
+  for (auto entity : renderables.Entities()) {
+    auto index = transforms.IndexOf(entity);
+    if (index != ComponentSet<Transform>::NULL_INDEX && visible[index]) {
+      out.push_back(entity);
+    }
+  }
+}
+
+// GL texture holding a texture's image alone, also when it is packed.
+static unsigned int GetSourceTexture(const Texture &texture) {
+  return texture.normal_page != 0 ? texture.source_texture : texture.texture;
+}
+
+// Picks the textures a sprite is drawn from. A packed color map is drawn from
+// its atlas page only with the normal map it was packed with, whose page
+// holds that map at the same spot; other normal maps need its own image.
+static void ResolveMaterial(const Renderable &renderable, SpriteDraw &sprite) {
+  auto &color = *renderable.color;
+  if (color.normal_page != 0 && color.packed_normal == renderable.normal) {
+    sprite.color_texture = color.texture;
+    sprite.normal_texture = color.normal_page;
+    sprite.uv_rect = color.uv_rect;
+    return;
+  }
+  sprite.color_texture = GetSourceTexture(color);
+  sprite.normal_texture = GetSourceTexture(*renderable.normal);
+  sprite.uv_rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+}
+
+static void EmitCommands(FramePacket &packet) {
+  // Small per-frame IDs for the shader and material fields of sort keys,
+  // numbered in order of first use. Materials are told apart by the GL
+  // textures they bind, so sprites packed into the same atlas page share one.
+  std::unordered_map<const Shader *, std::uint32_t> shader_ids;
+  std::map<std::tuple<const GPUData *, unsigned int, unsigned int>,
+           std::uint32_t>
+      material_ids;
+  std::size_t count = 0;
+  for (auto &camera : packet.cameras) {
+    count += camera.visible.size();
+  }
+  packet.queue.Reserve(count);
+  // Depth is the submission index, so sprites sharing everything above it
+  // keep entity order. Indices past the field clamp and tie, which the
+  // stable sort leaves in submission order as well.
+  std::uint32_t depth = 0;
+  for (std::uint32_t camera = 0; camera < packet.cameras.size(); camera++) {
+    for (auto slot : packet.cameras[camera].visible) {
+      auto &sprite = packet.sprites[slot];
+      auto next_shader = static_cast<std::uint32_t>(shader_ids.size());
+      auto shader =
+          shader_ids.try_emplace(sprite.shader, next_shader).first->second;
+      auto next_material = static_cast<std::uint32_t>(material_ids.size());
+      auto material =
+          material_ids
+              .try_emplace(
+                  {sprite.data, sprite.color_texture, sprite.normal_texture},
+                  next_material)
+              .first->second;
+      packet.queue.Push(MakeSortKey(SortKeyFields{.camera = camera,
+                                                  .layer = sprite.layer,
+                                                  .shader = shader,
+                                                  .material = material,
+                                                  .depth = depth++}),
+                        slot, camera);
+    }
+  }
+  packet.queue.Sort();
+}
+
+void ion::render::ExtractFrame(std::shared_ptr<World> world,
+                               FramePacket &packet) {
+  auto &cache = world->GetWorldTransforms();
+  auto &transforms = world->GetComponentSet<Transform>();
+  auto &renderables = world->GetComponentSet<Renderable>();
+  packet.tick = cache.synced_tick;
+
+  // Index of each transform's sprite in the packet, so a sprite seen by
+  // several cameras is copied once. Renderables missing an asset are marked
+  // INCOMPLETE_SLOT so they are counted once.
+  constexpr auto INCOMPLETE_SLOT = ComponentSet<Transform>::NULL_INDEX - 1;
+  auto &sprite_slots = packet.sprite_slots;
+  auto &candidates = packet.candidates;
+  sprite_slots.assign(transforms.Size(), ComponentSet<Transform>::NULL_INDEX);
+  auto projection = GetProjection();
+  auto extent = GetViewExtent();
+  for (auto [camera_id, camera, camera_transform] :
+       world->View<Camera, Transform>()) {
+    auto model = *cache.Get(transforms, camera_id);
+    auto &draw = packet.cameras.emplace_back();
+    draw.view = glm::translate(model.ToMat4(), glm::vec3{0.0, 0.0, -3.0});
+    draw.projection = projection;
+
+    // The view matrix is the camera model itself, so the visible world
+    // rectangle is the view volume mapped back through its inverse.
+    auto inverse = model.Inverse();
+    auto first_corner = inverse.TransformPoint(-extent);
+    AABB view{first_corner, first_corner};
+    for (auto corner : {glm::vec2(extent.x, -extent.y),
+                        glm::vec2(-extent.x, extent.y), extent}) {
+      auto point = inverse.TransformPoint(corner);
+      view.min = glm::min(view.min, point);
+      view.max = glm::max(view.max, point);
+    }
+
+    FindVisible(world, view, packet.visibility, candidates);
+    for (auto entity_id : candidates) {
+      auto &renderable = *renderables.Get(entity_id);
+      auto index = transforms.IndexOf(entity_id);
+      auto &slot = sprite_slots[index];
+      if (slot == INCOMPLETE_SLOT) {
+        continue;
       }
+      if (!renderable.shader || !renderable.data || !renderable.color ||
+          !renderable.normal) {
+        slot = INCOMPLETE_SLOT;
+        packet.culling.incomplete++;
+        continue;
+      }
+      if (slot == ComponentSet<Transform>::NULL_INDEX) {
+        auto &sprite_model = cache.models[index];
+        slot = static_cast<std::uint32_t>(packet.sprites.size());
+        auto &sprite = packet.sprites.emplace_back(SpriteDraw{
+            entity_id, sprite_model, static_cast<int>(sprite_model.layer),
+            renderable.shader.get(), renderable.data.get()});
+        ResolveMaterial(renderable, sprite);
+      }
+      draw.visible.push_back(slot);
     }
   }
+  EmitCommands(packet);
+  packet.culling.visible = static_cast<std::uint32_t>(packet.sprites.size());
+  packet.culling.culled = static_cast<std::uint32_t>(renderables.Size()) -
+                          packet.culling.visible - packet.culling.incomplete;
+
+  for (auto [entity_id, light, transform] : world->View<Light, Transform>()) {
+    auto model = cache.Get(transforms, entity_id);
+    packet.lights.push_back(
+        LightDraw{glm::vec3(model->tx, model->ty, model->layer), light});
+  }
+}
+
+// Uploads the model and uv rect of every queued command, in queue order.
+static void UploadInstances(const FramePacket &packet) {
+  auto &commands = packet.queue.Commands();
+  auto models_size = commands.size() * sizeof(Affine2D);
+  if (auto allocation =
+          stream_buffer.Allocate(commands.size() * INSTANCE_SIZE)) {
+    auto *models = static_cast<Affine2D *>(allocation.data);
+    auto *uv_rects = reinterpret_cast<glm::vec4 *>(
+        static_cast<unsigned char *>(allocation.data) + models_size);
+    for (std::size_t i = 0; i < commands.size(); i++) {
+      auto &sprite = packet.sprites[commands[i].sprite];
+      models[i] = sprite.model;
+      uv_rects[i] = sprite.uv_rect;
+    }
+    stream_buffer.Flush();
+    instance_source = allocation.buffer;
+    instance_base = allocation.offset;
+    instance_uv_base = allocation.offset + models_size;
+    return;
+  }
+  // Drawn outside a frame, or the ring grows to fit from the next frame on.
+  instances.resize(commands.size());
+  instance_uv_rects.resize(commands.size());
+  for (std::size_t i = 0; i < commands.size(); i++) {
+    auto &sprite = packet.sprites[commands[i].sprite];
+    instances[i] = sprite.model;
+    instance_uv_rects[i] = sprite.uv_rect;
+  }
+  if (instance_buffer == 0) {
+    glGenBuffers(1, &instance_buffer);
+  }
+  gl::BindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+  if (instances.size() > instance_capacity) {
+    instance_capacity = std::max(instances.size(), instance_capacity * 2);
+  }
+  // Orphan the previous contents so the driver need not wait for draws
+  // still reading them.
+  glBufferData(GL_ARRAY_BUFFER, instance_capacity * INSTANCE_SIZE, nullptr,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, models_size, instances.data());
+  glBufferSubData(GL_ARRAY_BUFFER, models_size,
+                  instance_uv_rects.size() * sizeof(glm::vec4),
+                  instance_uv_rects.data());
+  instance_source = instance_buffer;
+  instance_base = 0;
+  instance_uv_base = models_size;
+}
+
+// Binds the sprite's albedo and normal maps for the geometry pass.
+static void BindMaterial(const SpriteDraw &sprite) {
+  gl::BindTextureUnit(0, GL_TEXTURE_2D, sprite.color_texture);
+  sprite.shader->SetUniform(SAMPLE_UNIFORM, 0);
+  gl::BindTextureUnit(1, GL_TEXTURE_2D, sprite.normal_texture);
+  sprite.shader->SetUniform(NORMAL_SAMPLE_UNIFORM, 1);
 }
+
+static void DrawSprite(const CameraDraw &camera, const SpriteDraw &sprite) {
+  BindGPUData(*sprite.data);
+  sprite.shader->Use();
+  sprite.shader->SetUniform(LAYER_UNIFORM, sprite.layer);
+  sprite.shader->SetUniform(VIEW_UNIFORM, camera.view);
+  sprite.shader->SetUniform(PROJECTION_UNIFORM, camera.projection);
+  sprite.shader->SetUniform(MODEL_UNIFORM, sprite.model.ToMat4());
+  sprite.shader->SetUniform(UV_RECT_UNIFORM, sprite.uv_rect);
+  BindMaterial(sprite);
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+  draw_stats.draw_calls++;
+  draw_stats.instances++;
+}
+
+// Draws instances [first, first + count) of the uploaded instance buffer.
+static void DrawBatch(const CameraDraw &camera, const SpriteDraw &sprite,
+                      std::size_t first, std::size_t count) {
+  gl::BindVertexArray(sprite.data->instance_attrib);
+  sprite.shader->UseInstanced();
+  sprite.shader->SetUniform(VIEW_UNIFORM, camera.view);
+  sprite.shader->SetUniform(PROJECTION_UNIFORM, camera.projection);
+  BindMaterial(sprite);
+  gl::BindBuffer(GL_ARRAY_BUFFER, instance_source);
+  auto offset = instance_base + first * sizeof(Affine2D);
+  glEnableVertexAttribArray(INSTANCE_BASIS_LOCATION);
+  glVertexAttribPointer(INSTANCE_BASIS_LOCATION, 4, GL_FLOAT, GL_FALSE,
+                        sizeof(Affine2D), reinterpret_cast<const void *>(offset));
+  glVertexAttribDivisor(INSTANCE_BASIS_LOCATION, 1);
+  glEnableVertexAttribArray(INSTANCE_TRANSLATION_LOCATION);
+  glVertexAttribPointer(
+      INSTANCE_TRANSLATION_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(Affine2D),
+      reinterpret_cast<const void *>(offset + offsetof(Affine2D, tx)));
+  glVertexAttribDivisor(INSTANCE_TRANSLATION_LOCATION, 1);
+  glEnableVertexAttribArray(INSTANCE_UV_RECT_LOCATION);
+  glVertexAttribPointer(INSTANCE_UV_RECT_LOCATION, 4, GL_FLOAT, GL_FALSE,
+                        sizeof(glm::vec4),
+                        reinterpret_cast<const void *>(
+                            instance_uv_base + first * sizeof(glm::vec4)));
+  glVertexAttribDivisor(INSTANCE_UV_RECT_LOCATION, 1);
+  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0,
+                          static_cast<GLsizei>(count));
+  draw_stats.draw_calls++;
+  draw_stats.instances += static_cast<std::uint32_t>(count);
+}
+
+void ion::render::DrawWorld(const FramePacket &packet) {
+  auto &commands = packet.queue.Commands();
+  if (commands.empty()) {
+    return;
+  }
+  UploadInstances(packet);
+  std::size_t begin = 0;
+  while (begin < commands.size()) {
+    auto &command = commands[begin];
+    auto &camera = packet.cameras[command.camera];
+    auto &sprite = packet.sprites[command.sprite];
+    if (!sprite.shader->HasInstancedVariant()) {
+      DrawSprite(camera, sprite);
+      begin++;
+      continue;
+    }
+    // Equal keys above the depth field only mean equal state when no field
+    // was clamped, so the resources are compared as well.
+    auto end = begin + 1;
+    while (end < commands.size()) {
+      auto &next_command = commands[end];
+      auto &next = packet.sprites[next_command.sprite];
+      if ((next_command.key >> SORT_KEY_DEPTH_BITS) !=
+              (command.key >> SORT_KEY_DEPTH_BITS) ||
+          next_command.camera != command.camera ||
+          next.shader != sprite.shader || next.data != sprite.data ||
+          next.color_texture != sprite.color_texture ||
+          next.normal_texture != sprite.normal_texture) {
+        break;
+      }
+      end++;
+    }
+    DrawBatch(camera, sprite, begin, end - begin);
+    begin = end;
+  }
+}
+
+DrawStats ion::render::GetDrawStats() { return draw_stats; }
+void ion::render::ResetDrawStats() { draw_stats = DrawStats{}; }
+
 void ion::render::RunPass(std::shared_ptr<Framebuffer> in,
                           std::shared_ptr<Framebuffer> out,
                           std::shared_ptr<Shader> shader,
                           std::shared_ptr<GPUData> quad) {
   BindFramebuffer(out);
   shader->SetUniform("ION_PASS_IN", 0);
+  shader->SetUniform(UV_SCALE_UNIFORM, GetUVScale(*in));
   BindTexture(in, 0);
   BindData(quad);
   if (quad->element_enabled) {
@@ -333,7 +938,6 @@ void ion::render::RunPass(std::shared_ptr<Framebuffer> in,
   } else {
     glDrawArrays(GL_TRIANGLES, 0, 6);
   }
-  UnbindData();
 }
 
 void ion::render::Clear() {
@@ -345,69 +949,252 @@ void ion::render::Clear(glm::vec4 color) {
   glClearColor(color.r, color.g, color.b, color.a);
   glClear(GL_COLOR_BUFFER_BIT);
 }
-int ion::render::Render(std::shared_ptr<Framebuffer> color_fb,
-                        std::shared_ptr<Framebuffer> normal_fb,
+static void UploadTextureBuffer(TextureBuffer &target, GLenum format,
+                                const void *data, std::size_t size) {
+  if (target.buffer == 0) {
+    glGenBuffers(1, &target.buffer);
+    glGenTextures(1, &target.texture);
+  }
+  gl::BindBuffer(GL_TEXTURE_BUFFER, target.buffer);
+  glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+  gl::BindTexture(GL_TEXTURE_BUFFER, target.texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, format, target.buffer);
+}
+static void DestroyTextureBuffer(TextureBuffer &target) {
+  if (target.buffer != 0) {
+    gl::DeleteTexture(target.texture);
+    gl::DeleteBuffer(target.buffer);
+    target = TextureBuffer{};
+  }
+}
+
+// Distance in texture coordinates past which a point light contributes less
+// than LIGHT_CUTOFF, or a negative value if it reaches everywhere. Bounds
+// both the diffuse and the volumetric term of the deferred shader.
+static float GetLightReach(const Light &light) {
+  auto peak = std::max({light.color.r, light.color.g, light.color.b}) *
+              light.intensity *
+              (1.0f + std::max(light.volumetric_intensity, 0.0f));
+  if (peak <= LIGHT_CUTOFF) {
+    return 0.0f;
+  }
+  if (light.radial_falloff <= 0.0f) {
+    return -1.0f;
+  }
+  return std::sqrt((peak / LIGHT_CUTOFF - 1.0f) / light.radial_falloff);
+}
+
+// Calls func with the index of every tile the light's reach overlaps.
+template <typename Func>
+static void ForEachLightTile(const BinnedLight &light, glm::ivec2 tiles,
+                             glm::vec2 tile_extent, Func &&func) {
+  auto first_x = std::max(
+      static_cast<int>((light.center.x - light.radius) / tile_extent.x), 0);
+  auto first_y = std::max(
+      static_cast<int>((light.center.y - light.radius) / tile_extent.y), 0);
+  auto last_x = std::min(
+      static_cast<int>((light.center.x + light.radius) / tile_extent.x),
+      tiles.x - 1);
+  auto last_y = std::min(
+      static_cast<int>((light.center.y + light.radius) / tile_extent.y),
+      tiles.y - 1);
+  for (int y = first_y; y <= last_y; y++) {
+    for (int x = first_x; x <= last_x; x++) {
+      // Skip the tiles in the corners of the bounding box.
+      auto dx = std::max({x * tile_extent.x - light.center.x, 0.0f,
+                          light.center.x - (x + 1) * tile_extent.x});
+      auto dy = std::max({y * tile_extent.y - light.center.y, 0.0f,
+                          light.center.y - (y + 1) * tile_extent.y});
+      if (dx * dx + dy * dy <= light.radius * light.radius) {
+        func(y * tiles.x + x);
+      }
+    }
+  }
+}
+
+// Fills tile_ranges and tile_indices from binned_lights, as a compact list
+// of light indices per tile.
+static void BinLights(glm::ivec2 tiles, glm::vec2 tile_extent) {
+  auto tile_count = static_cast<std::size_t>(tiles.x) * tiles.y;
+  tile_ranges.assign(tile_count * 2, 0);
+  for (auto &light : binned_lights) {
+    ForEachLightTile(light, tiles, tile_extent,
+                     [](int tile) { tile_ranges[tile * 2 + 1]++; });
+  }
+  std::uint32_t offset = 0;
+  for (std::size_t tile = 0; tile < tile_count; tile++) {
+    tile_ranges[tile * 2] = offset;
+    offset += tile_ranges[tile * 2 + 1];
+    tile_ranges[tile * 2 + 1] = 0;
+  }
+  tile_indices.resize(offset);
+  for (auto &light : binned_lights) {
+    ForEachLightTile(light, tiles, tile_extent, [&light](int tile) {
+      auto &count = tile_ranges[tile * 2 + 1];
+      tile_indices[tile_ranges[tile * 2] + count] = light.index;
+      count++;
+    });
+  }
+}
+
+static void AppendLightTexels(glm::vec2 position, const Light &light) {
+  light_texels.push_back(glm::vec4(static_cast<float>(light.type), position.x,
+                                   position.y, light.intensity));
+  light_texels.push_back(glm::vec4(light.color, light.radial_falloff));
+  light_texels.push_back(
+      glm::vec4(light.volumetric_intensity, 0.0f, 0.0f, 0.0f));
+}
+
+int ion::render::Render(std::shared_ptr<Framebuffer> gbuffer,
                         std::shared_ptr<GPUData> quad,
                         std::shared_ptr<Shader> shader,
-                        std::shared_ptr<World> world) {
+                        const FramePacket &packet) {
   shader->Use();
   glClear(GL_COLOR_BUFFER_BIT);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, color_fb->colorbuffer);
+  BindTexture(gbuffer, 0, GBUFFER_ALBEDO);
   shader->SetUniform("color_texture", 0);
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, normal_fb->colorbuffer);
+  BindTexture(gbuffer, 1, GBUFFER_NORMAL);
   shader->SetUniform("normal_texture", 1);
-  shader->SetUniform("light_count",
-                     static_cast<int>(world->GetComponentSet<Light>().size()));
+  shader->SetUniform(UV_SCALE_UNIFORM, GetUVScale(*gbuffer));
 
   auto view = glm::mat4(1.0f);
-  float ortho_scale = 10.0f;
-  auto projection =
-      glm::ortho(-ortho_scale * (GetWindowSize().x / GetWindowSize().y),
-                 ortho_scale * (GetWindowSize().x / GetWindowSize().y),
-                 -ortho_scale, ortho_scale, 0.1f, 100.0f);
-  for (auto &[id, camera] : world->GetComponentSet<Camera>()) {
-    view = GetModelFromTransform(world->GetComponent<Transform>(id));
-    view = glm::translate(view, glm::vec3(0.0, 0.0, -3.0));
-  }
-
-  for (int i = 0; i < world->GetComponentSet<Light>().size(); i++) {
-    auto &[entity_id, light] =
-        *std::next(world->GetComponentSet<Light>().begin(), i);
-    auto transform = world->GetComponent<Transform>(entity_id);
-    glm::vec3 light_world_pos =
-        glm::vec3(transform->position, transform->layer);
-    glm::vec4 light_clip_pos =
-        projection * view * glm::vec4(light_world_pos, 1.0f);
-    glm::vec2 light_texcoord =
-        ((glm::vec2(light_clip_pos) / light_clip_pos.w) + 1.0f) * 0.5f;
-    // TODO: Pack data into vec4s, reduce calls by half.
-    shader->SetUniform("lights[" + std::to_string(i) + "].type",
-                       static_cast<int>(light->type));
-    shader->SetUniform("lights[" + std::to_string(i) + "].position",
-                       light_texcoord);
-    shader->SetUniform("lights[" + std::to_string(i) + "].color", light->color);
-    shader->SetUniform("lights[" + std::to_string(i) + "].intensity",
-                       light->intensity);
-    shader->SetUniform("lights[" + std::to_string(i) + "].radial_falloff",
-                       light->radial_falloff);
-    shader->SetUniform("lights[" + std::to_string(i) + "].volumetric_intensity",
-                       light->volumetric_intensity);
+  auto projection = GetProjection();
+  if (!packet.cameras.empty()) {
+    view = packet.cameras.back().view;
+    projection = packet.cameras.back().projection;
   }
+
+  // Lights evaluated at every fragment go first, then the binned ones.
+  light_texels.clear();
+  binned_lights.clear();
+  std::uint32_t global_count = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    for (auto &[light_world_pos, light] : packet.lights) {
+      glm::vec4 light_clip_pos =
+          projection * view * glm::vec4(light_world_pos, 1.0f);
+      glm::vec2 light_texcoord =
+          ((glm::vec2(light_clip_pos) / light_clip_pos.w) + 1.0f) * 0.5f;
+      auto reach =
+          light.type == LightType::GLOBAL ? -1.0f : GetLightReach(light);
+      if (reach == 0.0f || (pass == 0) != (reach < 0.0f)) {
+        continue;
+      }
+      auto index =
+          static_cast<std::uint32_t>(light_texels.size() / LIGHT_TEXELS);
+      AppendLightTexels(light_texcoord, light);
+      if (reach < 0.0f) {
+        global_count++;
+      } else {
+        binned_lights.push_back({light_texcoord, reach, index});
+      }
+    }
+  }
+  // Tiles cover the drawn area, which gl_FragCoord is relative to.
+  auto target_size = glm::vec2(GetViewportSize(*gbuffer));
+  auto tiles = glm::ivec2(
+      (static_cast<int>(target_size.x) + LIGHT_TILE_SIZE - 1) /
+          LIGHT_TILE_SIZE,
+      (static_cast<int>(target_size.y) + LIGHT_TILE_SIZE - 1) /
+          LIGHT_TILE_SIZE);
+  BinLights(tiles, glm::vec2(LIGHT_TILE_SIZE / target_size.x,
+                             LIGHT_TILE_SIZE / target_size.y));
+  // Lights without reach were skipped above and are not counted.
+  draw_stats.lights =
+      global_count + static_cast<std::uint32_t>(binned_lights.size());
+  draw_stats.light_tile_entries =
+      static_cast<std::uint32_t>(tile_indices.size());
+
+  // Texture buffers may not be empty.
+  if (light_texels.empty()) {
+    light_texels.resize(LIGHT_TEXELS);
+  }
+  if (tile_indices.empty()) {
+    tile_indices.push_back(0);
+  }
+  UploadTextureBuffer(light_data, GL_RGBA32F, light_texels.data(),
+                      light_texels.size() * sizeof(glm::vec4));
+  UploadTextureBuffer(light_tiles, GL_RG32UI, tile_ranges.data(),
+                      tile_ranges.size() * sizeof(std::uint32_t));
+  UploadTextureBuffer(light_indices, GL_R32UI, tile_indices.data(),
+                      tile_indices.size() * sizeof(std::uint32_t));
+  gl::BindTextureUnit(2, GL_TEXTURE_BUFFER, light_data.texture);
+  shader->SetUniform(LIGHT_DATA_UNIFORM, 2);
+  gl::BindTextureUnit(3, GL_TEXTURE_BUFFER, light_tiles.texture);
+  shader->SetUniform(LIGHT_TILES_UNIFORM, 3);
+  gl::BindTextureUnit(4, GL_TEXTURE_BUFFER, light_indices.texture);
+  shader->SetUniform(LIGHT_INDICES_UNIFORM, 4);
+  shader->SetUniform(GLOBAL_LIGHT_COUNT_UNIFORM,
+                     static_cast<int>(global_count));
+  shader->SetUniform(LIGHT_TILE_SIZE_UNIFORM, LIGHT_TILE_SIZE);
+  shader->SetUniform(LIGHT_TILES_X_UNIFORM, tiles.x);
+
   BindData(quad);
   glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-  UnbindData();
   return 0;
 }
 int ion::render::Quit() {
+  if (instance_buffer != 0) {
+    gl::DeleteBuffer(instance_buffer);
+    instance_buffer = 0;
+    instance_capacity = 0;
+  }
+  stream_buffer.Release();
+  DestroyTextureBuffer(light_data);
+  DestroyTextureBuffer(light_tiles);
+  DestroyTextureBuffer(light_indices);
+  for (auto &timer : frame_timers) {
+    if (timer.begin != 0) {
+      glDeleteQueries(1, &timer.begin);
+      glDeleteQueries(1, &timer.end);
+    }
+    for (auto &pass : timer.passes) {
+      glDeleteQueries(1, &pass.query);
+    }
+    timer = FrameTimer{};
+  }
   for (auto &[framebuffer, name] : internal::framebuffers) {
-    glDeleteFramebuffers(1, &framebuffer->framebuffer);
-    glDeleteTextures(1, &framebuffer->colorbuffer);
+    DeleteFramebufferObjects(*framebuffer);
   }
   internal::framebuffers.clear();
+  ion::res::StopTextureLoads();
+  ion::res::ReleaseTextureAtlas();
   glfwDestroyWindow(internal::window);
   glfwTerminate();
   return 0;
 }
-void ion::render::Present() { glfwSwapBuffers(internal::window); }
\ No newline at end of file
+void ion::render::Present() {
+  // Surfaceless and OSMesa contexts have no buffers to swap.
+  if (!r_config.headless) {
+    glfwSwapBuffers(internal::window);
+  }
+  auto now = glfwGetTime();
+  if (last_present > 0.0) {
+    frame_timing.frame_ms = static_cast<float>((now - last_present) * 1000.0);
+  }
+  last_present = now;
+}
+int ion::render::SaveScreenshot(const std::string &path,
+                                std::shared_ptr<Framebuffer> framebuffer) {
+  auto size = glm::ivec2(r_config.window_size);
+  if (framebuffer) {
+    size = GetFramebufferSize(*framebuffer);
+    gl::BindFramebuffer(framebuffer->framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+  } else {
+    gl::BindFramebuffer(0);
+  }
+  auto width = size.x;
+  auto height = size.y;
+  std::vector<unsigned char> pixels(static_cast<std::size_t>(width) * height *
+                                    3);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+  // GL rows run bottom to top.
+  stbi_flip_vertically_on_write(1);
+  if (!stbi_write_png(path.c_str(), width, height, 3, pixels.data(),
+                      width * 3)) {
+    printf("%d\n", FILE_WRITE_FAIL);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,158 @@
+#include "ion/render_graph.h"
+#include <algorithm>
+#include <string>
+
+// Frames a pooled target may sit unused before it is destroyed.
+constexpr std::uint32_t TARGET_IDLE_FRAMES = 120;
+
+static bool IsCompatible(const FramebufferInfo &a, const FramebufferInfo &b) {
+  return a.color_attachments == b.color_attachments &&
+         a.downscale == b.downscale && a.linear_filter == b.linear_filter;
+}
+
+RenderResource RenderGraph::Builder::Create(const FramebufferInfo &info) {
+  auto resource = static_cast<RenderResource>(graph.resources.size());
+  auto &created = graph.resources.emplace_back();
+  created.info = info;
+  created.info.recreate_on_resize = true;
+  created.info.dynamic_resolution = true;
+  Write(resource);
+  return resource;
+}
+
+void RenderGraph::Builder::Read(RenderResource resource) {
+  graph.passes[pass].reads.push_back(resource);
+}
+
+void RenderGraph::Builder::Write(RenderResource resource) {
+  graph.passes[pass].writes.push_back(resource);
+}
+
+void RenderGraph::Builder::SideEffect() {
+  graph.passes[pass].side_effect = true;
+}
+
+RenderResource RenderGraph::Import(std::shared_ptr<Framebuffer> framebuffer) {
+  auto resource = static_cast<RenderResource>(resources.size());
+  auto &imported = resources.emplace_back();
+  imported.framebuffer = std::move(framebuffer);
+  imported.imported = true;
+  return resource;
+}
+
+RenderGraph::Builder RenderGraph::BeginPass(std::string name) {
+  auto &pass = passes.emplace_back();
+  pass.name = std::move(name);
+  return Builder(*this, static_cast<std::uint32_t>(passes.size() - 1));
+}
+
+// Walks the passes backwards, keeping a pass if it has side effects, writes
+// an imported framebuffer or writes something a kept pass reads.
+void RenderGraph::Cull() {
+  std::vector<bool> needed(resources.size(), false);
+  for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass) {
+    auto kept = pass->side_effect;
+    for (auto resource : pass->writes) {
+      kept = kept || resources[resource].imported || needed[resource];
+    }
+    pass->culled = !kept;
+    if (kept) {
+      for (auto resource : pass->reads) {
+        needed[resource] = true;
+      }
+    }
+  }
+}
+
+std::shared_ptr<Framebuffer>
+RenderGraph::Acquire(const FramebufferInfo &info) {
+  for (auto &target : pool) {
+    if (!target.in_use && IsCompatible(target.info, info)) {
+      target.in_use = true;
+      target.idle_frames = 0;
+      return target.framebuffer;
+    }
+  }
+  auto &target = pool.emplace_back();
+  target.info = info;
+  target.info.name = "Transient " + std::to_string(pool.size() - 1);
+  target.framebuffer = ion::render::CreateFramebuffer(target.info);
+  target.in_use = true;
+  return target.framebuffer;
+}
+
+void RenderGraph::Release(const std::shared_ptr<Framebuffer> &framebuffer) {
+  for (auto &target : pool) {
+    if (target.framebuffer == framebuffer) {
+      target.in_use = false;
+    }
+  }
+}
+
+void RenderGraph::Execute() {
+  Cull();
+  stats = RenderGraphStats{};
+  stats.passes = static_cast<std::uint32_t>(passes.size());
+  for (std::uint32_t index = 0; index < passes.size(); index++) {
+    auto &pass = passes[index];
+    if (pass.culled) {
+      stats.culled_passes++;
+      continue;
+    }
+    auto use = [this, index](RenderResource resource) {
+      auto &used = resources[resource];
+      used.first_use = std::min(used.first_use, index);
+      used.last_use = std::max(used.last_use, index);
+    };
+    std::for_each(pass.reads.begin(), pass.reads.end(), use);
+    std::for_each(pass.writes.begin(), pass.writes.end(), use);
+  }
+
+  for (auto &target : pool) {
+    target.idle_frames++;
+  }
+  for (std::uint32_t index = 0; index < passes.size(); index++) {
+    auto &pass = passes[index];
+    if (pass.culled) {
+      continue;
+    }
+    for (auto &resource : resources) {
+      if (!resource.imported && resource.first_use == index) {
+        resource.framebuffer = Acquire(resource.info);
+        stats.transients++;
+      }
+    }
+    ion::render::BeginPassTimer(pass.name);
+    pass.execute(*this);
+    ion::render::EndPassTimer();
+    // Transients whose last reader has run hand their target to later ones.
+    for (auto &resource : resources) {
+      if (!resource.imported && resource.first_use != NULL_RENDER_RESOURCE &&
+          resource.last_use == index) {
+        Release(resource.framebuffer);
+      }
+    }
+  }
+
+  std::erase_if(pool, [](const Target &target) {
+    if (target.idle_frames <= TARGET_IDLE_FRAMES) {
+      return false;
+    }
+    ion::render::DestroyFramebuffer(target.framebuffer);
+    return true;
+  });
+  stats.targets = static_cast<std::uint32_t>(pool.size());
+  resources.clear();
+  passes.clear();
+}
+
+std::shared_ptr<Framebuffer> RenderGraph::Get(RenderResource resource) const {
+  return resources[resource].framebuffer;
+}
+
+void RenderGraph::ReleaseTargets() {
+  for (auto &target : pool) {
+    ion::render::DestroyFramebuffer(target.framebuffer);
+  }
+  pool.clear();
+}
@@ -0,0 +1,52 @@
+#include "ion/render_queue.h"
+#include <algorithm>
+#include <array>
+
+static std::uint64_t PackField(std::uint64_t key, std::uint32_t value,
+                               std::uint32_t bits) {
+  auto max = (std::uint32_t{1} << bits) - 1;
+  return (key << bits) | std::min(value, max);
+}
+
+std::uint64_t MakeSortKey(const SortKeyFields &fields) {
+  constexpr int LAYER_BIAS = 1 << (SORT_KEY_LAYER_BITS - 1);
+  auto layer = std::clamp(fields.layer + LAYER_BIAS, 0, 2 * LAYER_BIAS - 1);
+  std::uint64_t key = 0;
+  key = PackField(key, fields.pass, SORT_KEY_PASS_BITS);
+  key = PackField(key, fields.camera, SORT_KEY_CAMERA_BITS);
+  key = PackField(key, static_cast<std::uint32_t>(layer), SORT_KEY_LAYER_BITS);
+  key = PackField(key, fields.shader, SORT_KEY_SHADER_BITS);
+  key = PackField(key, fields.material, SORT_KEY_MATERIAL_BITS);
+  key = PackField(key, fields.depth, SORT_KEY_DEPTH_BITS);
+  return key;
+}
+
+void RenderQueue::Sort() {
+  if (commands.size() < 2) {
+    return;
+  }
+  std::uint64_t differing = 0;
+  for (auto &command : commands) {
+    differing |= command.key ^ commands.front().key;
+  }
+  scratch.resize(commands.size());
+  for (std::uint32_t shift = 0; shift < 64; shift += 8) {
+    if (((differing >> shift) & 0xFF) == 0) {
+      continue;
+    }
+    std::array<std::uint32_t, 256> offsets{};
+    for (auto &command : commands) {
+      offsets[(command.key >> shift) & 0xFF]++;
+    }
+    std::uint32_t offset = 0;
+    for (auto &bucket : offsets) {
+      auto count = bucket;
+      bucket = offset;
+      offset += count;
+    }
+    for (auto &command : commands) {
+      scratch[offsets[(command.key >> shift) & 0xFF]++] = command;
+    }
+    commands.swap(scratch);
+  }
+}
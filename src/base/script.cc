@@ -75,10 +75,10 @@ void ion::script::Update(std::shared_ptr<World> world) {
   if (!internal::python_initialized) {
     return;
   }
-  if (world->GetComponentSet<Script>().empty()) {
+  if (world->GetComponentSet<Script>().Empty()) {
     return;
   }
-  for (auto &[entity, script] : world->GetComponentSet<Script>()) {
-    internal::RunScript(script->path, script->module_name, script->parameters);
+  for (auto [entity, script] : world->View<Script>()) {
+    internal::RunScript(script.path, script.module_name, script.parameters);
   }
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #define OPENGL_LOG_SIZE 512
 #include "ion/shader.h"
 #include "ion/error_code.h"
+#include "ion/gl_state.h"
+#include <algorithm>
 #include <array>
 #include <filesystem>
 #include <fstream>
@@ -11,39 +13,105 @@
 #include <sstream>
 #include <string>
 
-void Shader::Use() { glUseProgram(program); }
+void Shader::Use() {
+  active_program = program;
+  ion::render::gl::UseProgram(program);
+}
+void Shader::UseInstanced() {
+  active_program = instanced_program;
+  ion::render::gl::UseProgram(instanced_program);
+}
 unsigned int Shader::GetProgram() { return program; }
 
-template <> int Shader::SetUniform<int>(std::string_view name, int value) {
-  auto loc = glGetUniformLocation(program, name.data());
-  glUniform1i(loc, value);
+void UniformTable::Reflect(unsigned int program) {
+  slots.clear();
+  int count = 0;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+  std::array<char, OPENGL_LOG_SIZE> name;
+  for (int i = 0; i < count; i++) {
+    int length = 0;
+    int size = 0;
+    GLenum type;
+    glGetActiveUniform(program, i, name.size(), &length, &size, &type,
+                       name.data());
+    std::string_view full_name(name.data(), length);
+    auto location = glGetUniformLocation(program, name.data());
+    if (location == -1) {
+      // Block members have no location of their own.
+      continue;
+    }
+    slots.push_back({UniformID(full_name).hash, location});
+    // Arrays of basic types are reported once as "name[0]"; elements are
+    // consecutive locations, and the bare name aliases the first element.
+    if (full_name.ends_with("[0]")) {
+      auto base = full_name.substr(0, full_name.size() - 3);
+      slots.push_back({UniformID(base).hash, location});
+      for (int element = 1; element < size; element++) {
+        auto element_name =
+            std::string(base) + "[" + std::to_string(element) + "]";
+        slots.push_back({UniformID(element_name).hash, location + element});
+      }
+    }
+  }
+  std::sort(slots.begin(), slots.end(),
+            [](const Slot &a, const Slot &b) { return a.hash < b.hash; });
+  for (std::size_t i = 1; i < slots.size(); i++) {
+    if (slots[i].hash == slots[i - 1].hash &&
+        slots[i].location != slots[i - 1].location) {
+      printf("Uniform name hash collision in program %u\n", program);
+    }
+  }
+}
+
+int UniformTable::Find(UniformID id) const {
+  auto slot = std::lower_bound(
+      slots.begin(), slots.end(), id.hash,
+      [](const Slot &a, std::uint32_t hash) { return a.hash < hash; });
+  if (slot == slots.end() || slot->hash != id.hash) {
+    return -1;
+  }
+  return slot->location;
+}
+
+int Shader::GetUniformLocation(UniformID id) const {
+  if (instanced_program != 0 && active_program == instanced_program) {
+    return instanced_uniforms.Find(id);
+  }
+  return uniforms.Find(id);
+}
+
+template <> int Shader::SetUniform<int>(UniformID id, int value) {
+  glUniform1i(GetUniformLocation(id), value);
   return 0;
 }
 
-template <> int Shader::SetUniform<float>(std::string_view name, float value) {
-  auto loc = glGetUniformLocation(program, name.data());
-  glUniform1f(loc, value);
+template <> int Shader::SetUniform<float>(UniformID id, float value) {
+  glUniform1f(GetUniformLocation(id), value);
+  return 0;
+}
+
+template <>
+int Shader::SetUniform<glm::vec2>(UniformID id, glm::vec2 value) {
+  glUniform2fv(GetUniformLocation(id), 1, glm::value_ptr(value));
   return 0;
 }
 
 template <>
-int Shader::SetUniform<glm::vec2>(std::string_view name, glm::vec2 value) {
-  auto loc = glGetUniformLocation(program, name.data());
-  glUniform2fv(loc, 1, glm::value_ptr(value));
+int Shader::SetUniform<glm::vec3>(UniformID id, glm::vec3 value) {
+  glUniform3fv(GetUniformLocation(id), 1, glm::value_ptr(value));
   return 0;
 }
 
 template <>
-int Shader::SetUniform<glm::vec3>(std::string_view name, glm::vec3 value) {
-  auto loc = glGetUniformLocation(program, name.data());
-  glUniform3fv(loc, 1, glm::value_ptr(value));
+int Shader::SetUniform<glm::vec4>(UniformID id, glm::vec4 value) {
+  glUniform4fv(GetUniformLocation(id), 1, glm::value_ptr(value));
   return 0;
 }
 
 template <>
-int Shader::SetUniform<glm::mat4>(std::string_view name, glm::mat4 value) {
-  auto loc = glGetUniformLocation(program, name.data());
-  glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(value));
+int Shader::SetUniform<glm::mat4>(UniformID id, glm::mat4 value) {
+  glUniformMatrix4fv(GetUniformLocation(id), 1, GL_FALSE,
+                     glm::value_ptr(value));
   return 0;
 }
 
@@ -63,47 +131,62 @@ std::string _ShaderInternalReadFile(std::filesystem::path path) {
   return data;
 }
 
-Shader::Shader(std::filesystem::path new_path, std::string_view new_id)
-    : path(new_path), id(new_id) {
-  unsigned int vertex, fragment;
-  int success;
+static unsigned int CompileStage(GLenum type, std::filesystem::path file,
+                                 int error_code) {
   std::array<char, OPENGL_LOG_SIZE> info_log;
-  vertex = glCreateShader(GL_VERTEX_SHADER);
-  fragment = glCreateShader(GL_FRAGMENT_SHADER);
-  auto vertex_code = _ShaderInternalReadFile(path / "vs.glsl"),
-       fragment_code = _ShaderInternalReadFile(path / "fs.glsl");
-  auto vertex_code_char = vertex_code.c_str(),
-       fragment_code_char = fragment_code.c_str();
-  glShaderSource(vertex, 1, &vertex_code_char, nullptr);
-  glCompileShader(vertex);
-  glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-  if (!success) {
-    glGetShaderInfoLog(vertex, info_log.size(), nullptr, info_log.data());
-    printf("Error while compiling vertex shader %s\n",
-           (path / "vs.glsl").c_str());
-    printf("%s\n", info_log.data());
-    printf("%d\n", VERTEX_COMPILATION_FAIL);
-  }
-  glShaderSource(fragment, 1, &fragment_code_char, nullptr);
-  glCompileShader(fragment);
-  glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+  int success;
+  auto stage = glCreateShader(type);
+  auto code = _ShaderInternalReadFile(file);
+  auto code_char = code.c_str();
+  glShaderSource(stage, 1, &code_char, nullptr);
+  glCompileShader(stage);
+  glGetShaderiv(stage, GL_COMPILE_STATUS, &success);
   if (!success) {
-    glGetShaderInfoLog(fragment, 512, nullptr, info_log.data());
-    printf("Error while compiling fragment shader %s\n",
-           (path / "fs.glsl").c_str());
+    glGetShaderInfoLog(stage, info_log.size(), nullptr, info_log.data());
+    printf("Error while compiling %s shader %s\n",
+           type == GL_VERTEX_SHADER ? "vertex" : "fragment",
+           file.string().c_str());
     printf("%s\n", info_log.data());
-    printf("%d\n", FRAGMENT_COMPILATION_FAIL);
+    printf("%d\n", error_code);
   }
-  program = glCreateProgram();
+  return stage;
+}
+
+static unsigned int LinkProgram(unsigned int vertex, unsigned int fragment) {
+  std::array<char, OPENGL_LOG_SIZE> info_log;
+  int success;
+  auto program = glCreateProgram();
   glAttachShader(program, vertex);
   glAttachShader(program, fragment);
   glLinkProgram(program);
   glGetProgramiv(program, GL_LINK_STATUS, &success);
   if (!success) {
-    glGetProgramInfoLog(program, 512, nullptr, info_log.data());
+    glGetProgramInfoLog(program, info_log.size(), nullptr, info_log.data());
     printf("%s\n", info_log.data());
     printf("%d\n", SHADER_PROGRAM_LINK_FAIL);
   }
+  return program;
+}
+
+Shader::Shader(std::filesystem::path new_path, std::string_view new_id)
+    : path(new_path), id(new_id) {
+  auto vertex =
+      CompileStage(GL_VERTEX_SHADER, path / "vs.glsl", VERTEX_COMPILATION_FAIL);
+  auto fragment = CompileStage(GL_FRAGMENT_SHADER, path / "fs.glsl",
+                               FRAGMENT_COMPILATION_FAIL);
+  program = LinkProgram(vertex, fragment);
+  uniforms.Reflect(program);
   glDeleteShader(vertex);
+  // Optional variant reading its model from per-instance attributes, sharing
+  // the fragment stage.
+  if (std::filesystem::exists(path / "vs_instanced.glsl")) {
+    auto instanced_vertex =
+        CompileStage(GL_VERTEX_SHADER, path / "vs_instanced.glsl",
+                     VERTEX_COMPILATION_FAIL);
+    instanced_program = LinkProgram(instanced_vertex, fragment);
+    instanced_uniforms.Reflect(instanced_program);
+    glDeleteShader(instanced_vertex);
+  }
   glDeleteShader(fragment);
+  active_program = program;
 }
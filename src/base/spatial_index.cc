@@ -0,0 +1,275 @@
+#include "ion/spatial_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+constexpr float DEGREES_TO_RADIANS = 0.01745329251994329577f;
+
+static std::uint64_t CellKey(int x, int y) {
+  return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) |
+         static_cast<std::uint32_t>(y);
+}
+
+// Entry and exit distances of a ray against a box, or false on a miss.
+static bool IntersectRay(glm::vec2 origin, glm::vec2 inverse_direction,
+                         const AABB &box, float &t_enter, float &t_exit) {
+  t_enter = -std::numeric_limits<float>::infinity();
+  t_exit = std::numeric_limits<float>::infinity();
+  for (int axis = 0; axis < 2; axis++) {
+    auto t_min = (box.min[axis] - origin[axis]) * inverse_direction[axis];
+    auto t_max = (box.max[axis] - origin[axis]) * inverse_direction[axis];
+    if (std::isnan(t_min) || std::isnan(t_max)) {
+      // Parallel to this slab and exactly on its boundary.
+      continue;
+    }
+    t_enter = std::max(t_enter, std::min(t_min, t_max));
+    t_exit = std::min(t_exit, std::max(t_min, t_max));
+  }
+  return t_enter <= t_exit;
+}
+
+AABB GetTransformBounds(const Transform &transform) {
+  auto radians = transform.rotation * DEGREES_TO_RADIANS;
+  auto cos = std::abs(std::cos(radians)), sin = std::abs(std::sin(radians));
+  auto half = glm::abs(transform.scale) * 0.5f;
+  auto extent =
+      glm::vec2(cos * half.x + sin * half.y, sin * half.x + cos * half.y);
+  return AABB{transform.position - extent, transform.position + extent};
+}
+
+AABB GetModelBounds(const Affine2D &model) {
+  // Half extents of the unit quad's axes after the linear part.
+  auto extent = glm::vec2(std::abs(model.a) + std::abs(model.c),
+                          std::abs(model.b) + std::abs(model.d)) *
+                0.5f;
+  auto center = glm::vec2(model.tx, model.ty);
+  return AABB{center - extent, center + extent};
+}
+
+SpatialIndex::SpatialIndex(float cell_size) : cell_size(cell_size) {}
+
+void SpatialIndex::Sync(const ComponentSet<Transform> &transforms,
+                        const TransformCache &world_transforms,
+                        std::uint32_t since) {
+  if (since == 0) {
+    Clear();
+  } else if (transforms.StructureVersion() > since) {
+    std::vector<EntityID> removed;
+    for (auto &[entity, entry] : entries) {
+      if (!transforms.Contains(entity)) {
+        removed.push_back(entity);
+      }
+    }
+    for (auto entity : removed) {
+      Remove(entity);
+    }
+  }
+  auto &versions = world_transforms.versions;
+  auto &models = world_transforms.models;
+  auto &entities = transforms.Entities();
+  for (std::size_t i = 0; i < versions.size(); i++) {
+    if (versions[i] > since) {
+      Insert(entities[i], GetModelBounds(models[i]));
+    }
+  }
+}
+
+glm::ivec2 SpatialIndex::CellOf(glm::vec2 point) const {
+  return glm::ivec2(static_cast<int>(std::floor(point.x / cell_size)),
+                    static_cast<int>(std::floor(point.y / cell_size)));
+}
+
+void SpatialIndex::Link(EntityID entity, glm::ivec2 min_cell,
+                        glm::ivec2 max_cell) {
+  for (int y = min_cell.y; y <= max_cell.y; y++) {
+    for (int x = min_cell.x; x <= max_cell.x; x++) {
+      cells[CellKey(x, y)].push_back(entity);
+    }
+  }
+}
+
+void SpatialIndex::Unlink(EntityID entity, glm::ivec2 min_cell,
+                          glm::ivec2 max_cell) {
+  for (int y = min_cell.y; y <= max_cell.y; y++) {
+    for (int x = min_cell.x; x <= max_cell.x; x++) {
+      auto cell = cells.find(CellKey(x, y));
+      if (cell == cells.end()) {
+        continue;
+      }
+      auto &list = cell->second;
+      auto it = std::find(list.begin(), list.end(), entity);
+      if (it != list.end()) {
+        *it = list.back();
+        list.pop_back();
+      }
+      if (list.empty()) {
+        cells.erase(cell);
+      }
+    }
+  }
+}
+
+void SpatialIndex::Insert(EntityID entity, const AABB &bounds) {
+  auto min_cell = CellOf(bounds.min);
+  auto max_cell = CellOf(bounds.max);
+  if (entries.empty()) {
+    extent = bounds;
+  } else {
+    extent.min = glm::min(extent.min, bounds.min);
+    extent.max = glm::max(extent.max, bounds.max);
+  }
+  auto [it, inserted] = entries.try_emplace(entity);
+  auto &entry = it->second;
+  if (!inserted) {
+    if (entry.min_cell == min_cell && entry.max_cell == max_cell) {
+      entry.bounds = bounds;
+      return;
+    }
+    Unlink(entity, entry.min_cell, entry.max_cell);
+  }
+  entry.bounds = bounds;
+  entry.min_cell = min_cell;
+  entry.max_cell = max_cell;
+  Link(entity, min_cell, max_cell);
+}
+
+void SpatialIndex::Remove(EntityID entity) {
+  auto it = entries.find(entity);
+  if (it == entries.end()) {
+    return;
+  }
+  Unlink(entity, it->second.min_cell, it->second.max_cell);
+  entries.erase(it);
+}
+
+void SpatialIndex::Clear() {
+  entries.clear();
+  cells.clear();
+  extent = AABB{};
+}
+
+const AABB *SpatialIndex::GetBounds(EntityID entity) const {
+  auto it = entries.find(entity);
+  return it == entries.end() ? nullptr : &it->second.bounds;
+}
+
+template <typename Func>
+void SpatialIndex::Visit(glm::ivec2 min_cell, glm::ivec2 max_cell,
+                         Func &&func) const {
+  auto stamp = ++query_stamp;
+  for (int y = min_cell.y; y <= max_cell.y; y++) {
+    for (int x = min_cell.x; x <= max_cell.x; x++) {
+      auto cell = cells.find(CellKey(x, y));
+      if (cell == cells.end()) {
+        continue;
+      }
+      for (auto entity : cell->second) {
+        auto &entry = entries.find(entity)->second;
+        if (entry.query_stamp != stamp) {
+          entry.query_stamp = stamp;
+          func(entity, entry);
+        }
+      }
+    }
+  }
+}
+
+void SpatialIndex::QueryAABB(const AABB &box,
+                             std::vector<EntityID> &out) const {
+  if (entries.empty() || !box.Overlaps(extent)) {
+    return;
+  }
+  // Clamp to the occupied region so huge boxes do not walk empty cells.
+  auto clamped = AABB{glm::max(box.min, extent.min),
+                      glm::min(box.max, extent.max)};
+  Visit(CellOf(clamped.min), CellOf(clamped.max),
+        [&](EntityID entity, const Entry &entry) {
+          if (entry.bounds.Overlaps(box)) {
+            out.push_back(entity);
+          }
+        });
+}
+
+void SpatialIndex::QueryRadius(glm::vec2 center, float radius,
+                               std::vector<EntityID> &out) const {
+  auto box = AABB{center - glm::vec2(radius), center + glm::vec2(radius)};
+  if (entries.empty() || !box.Overlaps(extent)) {
+    return;
+  }
+  auto clamped = AABB{glm::max(box.min, extent.min),
+                      glm::min(box.max, extent.max)};
+  Visit(CellOf(clamped.min), CellOf(clamped.max),
+        [&](EntityID entity, const Entry &entry) {
+          auto closest = glm::clamp(center, entry.bounds.min, entry.bounds.max);
+          auto offset = closest - center;
+          if (glm::dot(offset, offset) <= radius * radius) {
+            out.push_back(entity);
+          }
+        });
+}
+
+void SpatialIndex::Raycast(glm::vec2 origin, glm::vec2 direction,
+                           float max_distance, std::vector<RayHit> &out) const {
+  auto length = glm::length(direction);
+  if (entries.empty() || length == 0.0f) {
+    return;
+  }
+  direction /= length;
+  auto inverse_direction = 1.0f / direction;
+  float t, t_end;
+  if (!IntersectRay(origin, inverse_direction, extent, t, t_end)) {
+    return;
+  }
+  t = std::max(t, 0.0f);
+  t_end = std::min(t_end, max_distance);
+  if (t > t_end) {
+    return;
+  }
+
+  // Walk the cells along the ray (Amanatides-Woo).
+  auto first_hit = out.size();
+  auto stamp = ++query_stamp;
+  auto cell = CellOf(origin + direction * t);
+  auto last_cell = CellOf(origin + direction * t_end);
+  auto step = glm::ivec2(direction.x < 0.0f ? -1 : 1,
+                         direction.y < 0.0f ? -1 : 1);
+  glm::vec2 t_next, t_delta;
+  for (int axis = 0; axis < 2; axis++) {
+    if (direction[axis] == 0.0f) {
+      t_next[axis] = std::numeric_limits<float>::infinity();
+      t_delta[axis] = std::numeric_limits<float>::infinity();
+      continue;
+    }
+    auto boundary = (cell[axis] + (step[axis] > 0 ? 1 : 0)) * cell_size;
+    t_next[axis] = (boundary - origin[axis]) * inverse_direction[axis];
+    t_delta[axis] = cell_size * std::abs(inverse_direction[axis]);
+  }
+  while (true) {
+    auto it = cells.find(CellKey(cell.x, cell.y));
+    if (it != cells.end()) {
+      for (auto entity : it->second) {
+        auto &entry = entries.find(entity)->second;
+        if (entry.query_stamp == stamp) {
+          continue;
+        }
+        entry.query_stamp = stamp;
+        float t_enter, t_exit;
+        if (IntersectRay(origin, inverse_direction, entry.bounds, t_enter,
+                         t_exit) &&
+            t_exit >= 0.0f && t_enter <= max_distance) {
+          out.push_back(RayHit{entity, std::max(t_enter, 0.0f)});
+        }
+      }
+    }
+    if (cell == last_cell || std::min(t_next.x, t_next.y) > t_end) {
+      break;
+    }
+    auto axis = t_next.x < t_next.y ? 0 : 1;
+    cell[axis] += step[axis];
+    t_next[axis] += t_delta[axis];
+  }
+  std::sort(out.begin() + first_hit, out.end(),
+            [](const RayHit &a, const RayHit &b) {
+              return a.distance < b.distance;
+            });
+}
@@ -0,0 +1,157 @@
+#include "ion/stream_buffer.h"
+#include "ion/gl_state.h"
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <string_view>
+
+// Section size of a new ring, per frame.
+constexpr std::size_t INITIAL_SECTION_SIZE = 1 << 20;
+// Longest wait for a section's fence, in nanoseconds.
+constexpr GLuint64 FENCE_TIMEOUT = 1000000000;
+// GL_ARB_buffer_storage, which is not part of the 3.3 headers.
+constexpr GLbitfield MAP_PERSISTENT_BIT = 0x0040;
+constexpr GLbitfield MAP_COHERENT_BIT = 0x0080;
+using BufferStorageFunc = void(APIENTRY *)(GLenum target, GLsizeiptr size,
+                                           const void *data, GLbitfield flags);
+
+static BufferStorageFunc LoadBufferStorage() {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; i++) {
+    auto name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+    if (name && std::string_view(name) == "GL_ARB_buffer_storage") {
+      return reinterpret_cast<BufferStorageFunc>(
+          glfwGetProcAddress("glBufferStorage"));
+    }
+  }
+  return nullptr;
+}
+
+void StreamBuffer::Create(std::size_t size) {
+  Release();
+  static auto buffer_storage = LoadBufferStorage();
+  auto total = static_cast<GLsizeiptr>(size * FRAMES);
+  section_size = size;
+  glGenBuffers(1, &buffer);
+  ion::render::gl::BindBuffer(GL_ARRAY_BUFFER, buffer);
+  if (buffer_storage) {
+    auto flags = GL_MAP_WRITE_BIT | MAP_PERSISTENT_BIT | MAP_COHERENT_BIT;
+    buffer_storage(GL_ARRAY_BUFFER, total, nullptr, flags);
+    mapped = static_cast<unsigned char *>(
+        glMapBufferRange(GL_ARRAY_BUFFER, 0, total, flags));
+    if (!mapped) {
+      // Immutable storage cannot be respecified; start over with a new name.
+      ion::render::gl::DeleteBuffer(buffer);
+      glGenBuffers(1, &buffer);
+      ion::render::gl::BindBuffer(GL_ARRAY_BUFFER, buffer);
+    }
+  }
+  persistent = mapped != nullptr;
+  if (!persistent) {
+    glBufferData(GL_ARRAY_BUFFER, total, nullptr, GL_STREAM_DRAW);
+    staging.resize(size);
+  }
+}
+
+void StreamBuffer::BeginFrame() {
+  if (buffer == 0 || requested > section_size) {
+    Create(std::bit_ceil(
+        std::max({requested, section_size, INITIAL_SECTION_SIZE})));
+  }
+  if (auto fence = static_cast<GLsync>(fences[section])) {
+    auto status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      waits++;
+      status =
+          glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+    }
+    glDeleteSync(fence);
+    fences[section] = nullptr;
+    if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+      // The section is still being read. Rather than overwrite it, start a
+      // new buffer; GL keeps the old one alive until the GPU is done.
+      Create(section_size);
+    }
+  }
+  used = 0;
+  flushed = 0;
+  requested = 0;
+  in_frame = true;
+}
+
+StreamAllocation StreamBuffer::Allocate(std::size_t size,
+                                        std::size_t alignment) {
+  if (!in_frame) {
+    return {};
+  }
+  auto offset = (used + alignment - 1) / alignment * alignment;
+  requested += size + alignment - 1;
+  if (offset + size > section_size) {
+    return {};
+  }
+  used = offset + size;
+  auto base = section * section_size;
+  auto *data = persistent ? mapped + base + offset : staging.data() + offset;
+  return {data, buffer, base + offset, size};
+}
+
+void StreamBuffer::Flush() {
+  if (persistent || used == flushed) {
+    flushed = used;
+    return;
+  }
+  // The section's fence has passed, so an unsynchronized map cannot
+  // overwrite anything the GPU still reads.
+  ion::render::gl::BindBuffer(GL_ARRAY_BUFFER, buffer);
+  auto *target = glMapBufferRange(
+      GL_ARRAY_BUFFER, section * section_size + flushed, used - flushed,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+          GL_MAP_UNSYNCHRONIZED_BIT);
+  if (target) {
+    std::memcpy(target, staging.data() + flushed, used - flushed);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  flushed = used;
+}
+
+void StreamBuffer::EndFrame() {
+  if (!in_frame) {
+    return;
+  }
+  Flush();
+  fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  section = (section + 1) % FRAMES;
+  in_frame = false;
+}
+
+void StreamBuffer::Release() {
+  for (auto &fence : fences) {
+    if (fence) {
+      glDeleteSync(static_cast<GLsync>(fence));
+      fence = nullptr;
+    }
+  }
+  if (buffer != 0) {
+    if (mapped) {
+      ion::render::gl::BindBuffer(GL_ARRAY_BUFFER, buffer);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+      mapped = nullptr;
+    }
+    ion::render::gl::DeleteBuffer(buffer);
+    buffer = 0;
+  }
+  persistent = false;
+  staging.clear();
+  section = 0;
+  section_size = 0;
+  used = 0;
+  flushed = 0;
+  in_frame = false;
+}
+
+StreamBufferStats StreamBuffer::GetStats() const {
+  return {used, section_size, waits, persistent};
+}
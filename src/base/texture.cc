@@ -1,4 +1,7 @@
 #include "ion/texture.h"
+#include "ion/gl_state.h"
 #include <glad/glad.h>
 
-void Texture::Use() { glBindTexture(GL_TEXTURE_2D, texture); }
\ No newline at end of file
+void Texture::Use() {
+  ion::render::gl::BindTexture(GL_TEXTURE_2D, texture);
+}
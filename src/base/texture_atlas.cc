@@ -0,0 +1,265 @@
+#include "ion/texture_atlas.h"
+#include "ion/component.h"
+#include "ion/gl_state.h"
+#include "ion/render.h"
+#include "ion/texture.h"
+#include "ion/world.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <map>
+#include <set>
+#include <stb_image.h>
+
+// Largest page side; clamped to GL_MAX_TEXTURE_SIZE.
+constexpr int ATLAS_PAGE_SIZE = 2048;
+// Transparent gutter right of and above each sprite. Two texels keep the
+// first mip level from blending neighbours, so pages stop there.
+constexpr int ATLAS_PADDING = 2;
+constexpr int ATLAS_MAX_LEVEL = 1;
+
+static std::vector<AtlasPage> atlas_pages;
+
+SkylinePacker::SkylinePacker(glm::ivec2 page_size) : size(page_size) {
+  skyline.push_back({0, 0, size.x});
+}
+
+int SkylinePacker::Fit(std::size_t index, glm::ivec2 rect) const {
+  auto x = skyline[index].x;
+  if (x + rect.x > size.x) {
+    return -1;
+  }
+  auto y = 0;
+  auto remaining = rect.x;
+  for (auto i = index; remaining > 0; i++) {
+    y = std::max(y, skyline[i].y);
+    if (y + rect.y > size.y) {
+      return -1;
+    }
+    remaining -= skyline[i].width;
+  }
+  return y + rect.y;
+}
+
+bool SkylinePacker::Insert(glm::ivec2 rect, glm::ivec2 &position) {
+  auto best = skyline.size();
+  auto best_top = size.y + 1;
+  for (std::size_t i = 0; i < skyline.size(); i++) {
+    auto top = Fit(i, rect);
+    if (top >= 0 && top < best_top) {
+      best = i;
+      best_top = top;
+    }
+  }
+  if (best == skyline.size()) {
+    return false;
+  }
+  position = glm::ivec2(skyline[best].x, best_top - rect.y);
+  skyline.insert(skyline.begin() + best, {position.x, best_top, rect.x});
+  // Trim the segments now covered by the new one.
+  auto right = position.x + rect.x;
+  auto next = best + 1;
+  while (next < skyline.size() && skyline[next].x < right) {
+    auto overlap = right - skyline[next].x;
+    if (overlap >= skyline[next].width) {
+      skyline.erase(skyline.begin() + next);
+      continue;
+    }
+    skyline[next].x += overlap;
+    skyline[next].width -= overlap;
+    break;
+  }
+  // Merge neighbours of equal height.
+  for (std::size_t i = 0; i + 1 < skyline.size();) {
+    if (skyline[i].y == skyline[i + 1].y) {
+      skyline[i].width += skyline[i + 1].width;
+      skyline.erase(skyline.begin() + i + 1);
+    } else {
+      i++;
+    }
+  }
+  return true;
+}
+
+int SkylinePacker::GetHeight() const {
+  auto height = 0;
+  for (auto &segment : skyline) {
+    height = std::max(height, segment.y);
+  }
+  return height;
+}
+
+namespace {
+struct Image {
+  unsigned char *pixels = nullptr;
+  glm::ivec2 size = glm::ivec2(0);
+};
+struct Sprite {
+  std::shared_ptr<Texture> color;
+  std::shared_ptr<Texture> normal;
+  Image color_image;
+  Image normal_image;
+  glm::ivec2 position = glm::ivec2(0);
+};
+struct PendingPage {
+  SkylinePacker packer;
+  std::vector<std::size_t> sprites;
+};
+} // namespace
+
+// Loads an image as RGBA8.
+static Image LoadImage(const Texture &texture) {
+  Image image;
+  int channels = 0;
+  image.pixels = stbi_load(texture.GetPath().string().c_str(), &image.size.x,
+                           &image.size.y, &channels, 4);
+  return image;
+}
+
+static void CopyImage(const Image &image, glm::ivec2 position,
+                      int page_width, std::vector<unsigned char> &page) {
+  auto row_size = static_cast<std::size_t>(image.size.x) * 4;
+  for (int row = 0; row < image.size.y; row++) {
+    auto offset =
+        (static_cast<std::size_t>(position.y + row) * page_width + position.x) *
+        4;
+    std::memcpy(page.data() + offset, image.pixels + row * row_size, row_size);
+  }
+}
+
+static unsigned int UploadPage(std::vector<unsigned char> &pixels,
+                               glm::ivec2 size) {
+  auto texture = ion::render::ConfigureTexture(
+      TextureInfo{pixels.data(), size.x, size.y, 4});
+  ion::render::gl::BindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ATLAS_MAX_LEVEL);
+  return texture;
+}
+
+std::size_t ion::res::BuildTextureAtlas(std::shared_ptr<World> world) {
+  // Normal map each color is drawn with. Colors that need a second layout
+  // for their normal map cannot share one uv_rect with it.
+  std::map<const Texture *,
+           std::pair<std::shared_ptr<Texture>, std::shared_ptr<Texture>>>
+      pairs;
+  std::set<const Texture *> excluded;
+  for (auto [entity, renderable] : world->GetComponentSet<Renderable>()) {
+    if (!renderable.color || !renderable.normal) {
+      continue;
+    }
+    excluded.insert(renderable.normal.get());
+    auto [pair, inserted] = pairs.try_emplace(
+        renderable.color.get(), renderable.color, renderable.normal);
+    if (!inserted && pair->second.second != renderable.normal) {
+      excluded.insert(renderable.color.get());
+    }
+  }
+
+  GLint max_texture_size = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+  auto page_side =
+      std::min(ATLAS_PAGE_SIZE, static_cast<int>(max_texture_size));
+  std::vector<Sprite> sprites;
+  for (auto &[key, pair] : pairs) {
+    auto &[color, normal] = pair;
+    if (excluded.contains(key) || color->normal_page != 0 || color->loading ||
+        normal->loading) {
+      continue;
+    }
+    auto sprite =
+        Sprite{color, normal, LoadImage(*color), LoadImage(*normal)};
+    auto size = sprite.color_image.size;
+    if (!sprite.color_image.pixels || !sprite.normal_image.pixels ||
+        size != sprite.normal_image.size ||
+        size.x + ATLAS_PADDING > page_side ||
+        size.y + ATLAS_PADDING > page_side) {
+      stbi_image_free(sprite.color_image.pixels);
+      stbi_image_free(sprite.normal_image.pixels);
+      continue;
+    }
+    sprites.push_back(std::move(sprite));
+  }
+  // Tallest first packs a skyline tightest.
+  std::sort(sprites.begin(), sprites.end(), [](auto &a, auto &b) {
+    if (a.color_image.size.y != b.color_image.size.y) {
+      return a.color_image.size.y > b.color_image.size.y;
+    }
+    return a.color_image.size.x > b.color_image.size.x;
+  });
+
+  std::vector<PendingPage> pending;
+  for (std::size_t i = 0; i < sprites.size(); i++) {
+    auto rect = sprites[i].color_image.size + glm::ivec2(ATLAS_PADDING);
+    auto placed = false;
+    for (std::size_t page = 0; page < pending.size() && !placed; page++) {
+      if (pending[page].packer.Insert(rect, sprites[i].position)) {
+        pending[page].sprites.push_back(i);
+        placed = true;
+      }
+    }
+    if (!placed) {
+      auto &page = pending.emplace_back(
+          PendingPage{SkylinePacker(glm::ivec2(page_side)), {}});
+      page.packer.Insert(rect, sprites[i].position);
+      page.sprites.push_back(i);
+    }
+  }
+
+  for (auto &page : pending) {
+    // Pages are cut down to the height they use.
+    auto size = glm::ivec2(
+        page_side, std::min(std::bit_ceil(static_cast<unsigned int>(
+                                page.packer.GetHeight())),
+                            static_cast<unsigned int>(page_side)));
+    auto page_bytes = static_cast<std::size_t>(size.x) * size.y * 4;
+    std::vector<unsigned char> color_pixels(page_bytes, 0);
+    std::vector<unsigned char> normal_pixels(page_bytes, 0);
+    for (auto index : page.sprites) {
+      auto &sprite = sprites[index];
+      CopyImage(sprite.color_image, sprite.position, size.x, color_pixels);
+      CopyImage(sprite.normal_image, sprite.position, size.x, normal_pixels);
+    }
+    auto &atlas = atlas_pages.emplace_back(
+        AtlasPage{UploadPage(color_pixels, size),
+                  UploadPage(normal_pixels, size), size,
+                  static_cast<std::uint32_t>(page.sprites.size()),
+                  world.get(), {}});
+    for (auto index : page.sprites) {
+      auto &sprite = sprites[index];
+      atlas.textures.push_back(sprite.color);
+      sprite.color->source_texture = sprite.color->texture;
+      sprite.color->texture = atlas.color;
+      sprite.color->normal_page = atlas.normal;
+      sprite.color->packed_normal = sprite.normal;
+      sprite.color->uv_rect =
+          glm::vec4(glm::vec2(sprite.position) / glm::vec2(size),
+                    glm::vec2(sprite.color_image.size) / glm::vec2(size));
+    }
+  }
+  for (auto &sprite : sprites) {
+    stbi_image_free(sprite.color_image.pixels);
+    stbi_image_free(sprite.normal_image.pixels);
+  }
+  return sprites.size();
+}
+
+void ion::res::ReleaseTextureAtlas(const World *world) {
+  std::erase_if(atlas_pages, [world](AtlasPage &page) {
+    if (world && page.world != world) {
+      return false;
+    }
+    for (auto &texture : page.textures) {
+      texture->texture = texture->source_texture;
+      texture->uv_rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+      texture->normal_page = 0;
+      texture->source_texture = 0;
+      texture->packed_normal.reset();
+    }
+    ion::render::gl::DeleteTexture(page.color);
+    ion::render::gl::DeleteTexture(page.normal);
+    return true;
+  });
+}
+
+const std::vector<AtlasPage> &ion::res::GetAtlasPages() { return atlas_pages; }
@@ -0,0 +1,394 @@
+#include "ion/texture_loader.h"
+#include <glad/glad.h>
+
+#include "ion/assets.h"
+#include "ion/defaults.h"
+#include "ion/gl_state.h"
+#include "ion/render.h"
+#include "ion/texture.h"
+#include "ion/texture_atlas.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stb_image.h>
+#include <thread>
+#include <vector>
+
+constexpr unsigned int MAX_TEXTURE_WORKERS = 4;
+// Pixel buffer memory mapped for the workers at once. One load is staged
+// even if it is larger on its own.
+constexpr std::size_t MAX_STAGED_BYTES = 64 << 20;
+
+namespace {
+// A load is read by a worker (copy and image size), gets a mapped pixel
+// buffer on the main thread, is decoded into it by a worker, starts its
+// texture transfer on the main thread and is finished there an update later.
+struct TextureLoad {
+  std::shared_ptr<Texture> texture;
+  // Copied to the texture's path first when not empty.
+  std::filesystem::path source;
+  int width = 0;
+  int height = 0;
+  unsigned int pixel_buffer = 0;
+  void *mapped = nullptr;
+  unsigned int gl_texture = 0;
+  bool failed = false;
+
+  std::size_t GetSize() const {
+    return static_cast<std::size_t>(width) * height * 4;
+  }
+};
+} // namespace
+
+static bool async_loading = false;
+static unsigned int placeholder = 0;
+static std::vector<std::thread> workers;
+static std::mutex load_mutex;
+static std::condition_variable load_condition;
+// Worker input.
+static std::deque<TextureLoad> read_queue;
+static std::deque<TextureLoad> fill_queue;
+// Main thread input.
+static std::deque<TextureLoad> sized_queue;
+static std::deque<TextureLoad> filled_queue;
+// Loads queued and not finished yet.
+static std::size_t pending_loads = 0;
+static bool stopping = false;
+// Owned by the main thread.
+static std::vector<TextureLoad> transfers;
+static std::size_t staged_bytes = 0;
+static std::vector<std::weak_ptr<World>> atlas_worlds;
+
+static void ReadTexture(TextureLoad &load) {
+  auto path = load.texture->GetPath();
+  if (!load.source.empty()) {
+    std::error_code error;
+    std::filesystem::copy_file(std::filesystem::absolute(load.source), path,
+                               std::filesystem::copy_options::update_existing,
+                               error);
+    if (error) {
+      printf("Failed to import texture: Path: %s, Reason: %s\n",
+             load.source.string().c_str(), error.message().c_str());
+      load.failed = true;
+      return;
+    }
+  }
+  int channels;
+  if (!stbi_info(path.string().c_str(), &load.width, &load.height,
+                 &channels)) {
+    printf("Failed to load texture image: Path: %s, Reason: %s\n",
+           path.string().c_str(), stbi_failure_reason());
+    load.failed = true;
+  }
+}
+
+static void FillTexture(TextureLoad &load) {
+  auto path = load.texture->GetPath();
+  int width, height, channels;
+  // Decoded as RGBA so every row is 4 byte aligned for the upload.
+  auto *data =
+      stbi_load(path.string().c_str(), &width, &height, &channels, 4);
+  if (!data) {
+    printf("Failed to load texture image: Path: %s, Reason: %s\n",
+           path.string().c_str(), stbi_failure_reason());
+    load.failed = true;
+    return;
+  }
+  if (width != load.width || height != load.height) {
+    printf("Texture image changed while loading: Path: %s\n",
+           path.string().c_str());
+    load.failed = true;
+  } else {
+    std::memcpy(load.mapped, data, load.GetSize());
+  }
+  stbi_image_free(data);
+}
+
+static void RunWorker() {
+  while (true) {
+    TextureLoad load;
+    bool fill;
+    {
+      std::unique_lock lock(load_mutex);
+      load_condition.wait(lock, [] {
+        return stopping || !fill_queue.empty() || !read_queue.empty();
+      });
+      if (stopping) {
+        return;
+      }
+      // Staged loads first, so mapped memory is given back soonest.
+      fill = !fill_queue.empty();
+      auto &queue = fill ? fill_queue : read_queue;
+      load = std::move(queue.front());
+      queue.pop_front();
+    }
+    if (fill) {
+      FillTexture(load);
+    } else {
+      ReadTexture(load);
+    }
+    std::lock_guard lock(load_mutex);
+    (fill ? filled_queue : sized_queue).push_back(std::move(load));
+  }
+}
+
+static void StartWorkers() {
+  if (!workers.empty()) {
+    return;
+  }
+  // One core is left to the main thread.
+  auto count = std::clamp(std::thread::hardware_concurrency(), 2u,
+                          MAX_TEXTURE_WORKERS + 1) -
+               1;
+  for (unsigned int i = 0; i < count; i++) {
+    workers.emplace_back(RunWorker);
+  }
+}
+
+static unsigned int GetPlaceholder() {
+  if (placeholder == 0) {
+    TextureInfo info{};
+    info.data = stbi_load(ION_DEFAULT_COLOR_TEXTURE, &info.width, &info.height,
+                          &info.nr_channels, 0);
+    placeholder = ion::render::ConfigureTexture(info);
+    stbi_image_free(info.data);
+  }
+  return placeholder;
+}
+
+static void FinishLoad() {
+  std::lock_guard lock(load_mutex);
+  pending_loads--;
+}
+
+// Maps a pixel buffer for the worker to decode into.
+static bool StageLoad(TextureLoad &load) {
+  glGenBuffers(1, &load.pixel_buffer);
+  ion::render::gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, load.pixel_buffer);
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, load.GetSize(), nullptr,
+               GL_STREAM_DRAW);
+  load.mapped = glMapBufferRange(
+      GL_PIXEL_UNPACK_BUFFER, 0, load.GetSize(),
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  ion::render::gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  if (!load.mapped) {
+    printf("Failed to map texture staging buffer: Path: %s\n",
+           load.texture->GetPath().string().c_str());
+    ion::render::gl::DeleteBuffer(load.pixel_buffer);
+    return false;
+  }
+  staged_bytes += load.GetSize();
+  return true;
+}
+
+// Unmaps the filled pixel buffer and starts the transfer into a new texture.
+static bool StartTransfer(TextureLoad &load) {
+  ion::render::gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, load.pixel_buffer);
+  bool intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+  load.mapped = nullptr;
+  staged_bytes -= load.GetSize();
+  if (!load.failed && intact) {
+    glGenTextures(1, &load.gl_texture);
+    ion::render::gl::BindTexture(GL_TEXTURE_2D, load.gl_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, load.width, load.height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  }
+  ion::render::gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  if (load.gl_texture == 0) {
+    ion::render::gl::DeleteBuffer(load.pixel_buffer);
+    return false;
+  }
+  return true;
+}
+
+// Builds the mipmaps of a transfer started an update earlier and swaps the
+// texture in for the placeholder.
+static void FinishTransfer(TextureLoad &load) {
+  ion::render::gl::BindTexture(GL_TEXTURE_2D, load.gl_texture);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_NEAREST_MIPMAP_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  ion::render::gl::DeleteBuffer(load.pixel_buffer);
+  load.texture->texture = load.gl_texture;
+  load.texture->loading = false;
+}
+
+// Failed loads keep the placeholder, but are no longer loading so the atlas
+// does not wait on them.
+static void FailLoad(TextureLoad &load) {
+  load.texture->loading = false;
+  FinishLoad();
+}
+
+// Detaches a texture whose load was dropped from the placeholder, which is
+// deleted, and lets the atlas pack it from its image again.
+static void DropLoad(TextureLoad &load) {
+  load.texture->texture = 0;
+  load.texture->loading = false;
+}
+
+void ion::res::SetAsyncTextureLoading(bool enabled) { async_loading = enabled; }
+
+bool ion::res::GetAsyncTextureLoading() { return async_loading; }
+
+std::shared_ptr<Texture>
+ion::res::internal::LoadTextureAsync(const std::filesystem::path &source,
+                                     const std::string &id) {
+  auto texture = std::make_shared<Texture>(GetProjectRoot() / id, id);
+  texture->texture = GetPlaceholder();
+  texture->loading = true;
+  textures.insert({id, texture});
+  StartWorkers();
+  {
+    std::lock_guard lock(load_mutex);
+    read_queue.push_back(TextureLoad{texture, source});
+    pending_loads++;
+  }
+  load_condition.notify_one();
+  return texture;
+}
+
+void ion::res::internal::BuildTextureAtlasWhenLoaded(
+    std::shared_ptr<World> world) {
+  if (GetPendingTextureLoads() == 0) {
+    BuildTextureAtlas(world);
+  } else {
+    atlas_worlds.push_back(world);
+  }
+}
+
+void ion::res::UpdateTextureLoads(float budget_ms) {
+  auto start = std::chrono::steady_clock::now();
+  auto budget = std::chrono::duration<float, std::milli>(budget_ms);
+  auto in_budget = [&] {
+    return std::chrono::steady_clock::now() - start < budget;
+  };
+  // Transfers started by the last call; the copy has had a frame to run.
+  // At least one step of each kind per call, so loads finish however small
+  // the budget.
+  auto finishing = std::move(transfers);
+  transfers.clear();
+  std::size_t finished = 0;
+  while (finished < finishing.size() && (finished == 0 || in_budget())) {
+    FinishTransfer(finishing[finished++]);
+    FinishLoad();
+  }
+  transfers.assign(std::make_move_iterator(finishing.begin() + finished),
+                   std::make_move_iterator(finishing.end()));
+
+  bool started = false;
+  while (!started || in_budget()) {
+    TextureLoad load;
+    {
+      std::lock_guard lock(load_mutex);
+      if (filled_queue.empty()) {
+        break;
+      }
+      load = std::move(filled_queue.front());
+      filled_queue.pop_front();
+    }
+    started = true;
+    if (StartTransfer(load)) {
+      transfers.push_back(std::move(load));
+    } else {
+      FailLoad(load);
+    }
+  }
+
+  bool staged = false;
+  while (!staged || in_budget()) {
+    TextureLoad load;
+    {
+      std::lock_guard lock(load_mutex);
+      if (sized_queue.empty() ||
+          (staged_bytes != 0 &&
+           staged_bytes + sized_queue.front().GetSize() > MAX_STAGED_BYTES)) {
+        break;
+      }
+      load = std::move(sized_queue.front());
+      sized_queue.pop_front();
+    }
+    staged = true;
+    if (load.failed || !StageLoad(load)) {
+      FailLoad(load);
+      continue;
+    }
+    {
+      std::lock_guard lock(load_mutex);
+      fill_queue.push_back(std::move(load));
+    }
+    load_condition.notify_one();
+  }
+
+  if (!atlas_worlds.empty() && GetPendingTextureLoads() == 0) {
+    for (auto &weak_world : atlas_worlds) {
+      if (auto world = weak_world.lock()) {
+        BuildTextureAtlas(world);
+      }
+    }
+    atlas_worlds.clear();
+  }
+}
+
+std::size_t ion::res::GetPendingTextureLoads() {
+  std::lock_guard lock(load_mutex);
+  return pending_loads;
+}
+
+void ion::res::StopTextureLoads() {
+  {
+    std::lock_guard lock(load_mutex);
+    stopping = true;
+  }
+  load_condition.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+  std::lock_guard lock(load_mutex);
+  // Started transfers only lack their mipmaps, so they are finished.
+  for (auto &load : transfers) {
+    FinishTransfer(load);
+  }
+  transfers.clear();
+  // Staged buffers are still mapped; unmap them before deleting.
+  for (auto *queue : {&fill_queue, &filled_queue}) {
+    for (auto &load : *queue) {
+      if (load.mapped) {
+        ion::render::gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, load.pixel_buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        ion::render::gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      }
+      ion::render::gl::DeleteBuffer(load.pixel_buffer);
+      DropLoad(load);
+    }
+    queue->clear();
+  }
+  for (auto *queue : {&read_queue, &sized_queue}) {
+    for (auto &load : *queue) {
+      DropLoad(load);
+    }
+    queue->clear();
+  }
+  if (placeholder != 0) {
+    // Textures whose load failed still show it.
+    for (auto &[id, texture] : internal::textures) {
+      if (texture->texture == placeholder) {
+        texture->texture = 0;
+      }
+    }
+    ion::render::gl::DeleteTexture(placeholder);
+    placeholder = 0;
+  }
+  atlas_worlds.clear();
+  staged_bytes = 0;
+  pending_loads = 0;
+  stopping = false;
+}
@@ -0,0 +1,383 @@
+#include "ion/transform_cache.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ION_TRANSFORM_SSE2
+#endif
+
+constexpr float DEGREES_TO_RADIANS = 0.01745329251994329577f;
+
+Affine2D Affine2D::Inverse() const {
+  auto determinant = a * d - b * c;
+  if (determinant == 0.0f) {
+    return Affine2D{};
+  }
+  auto inverse = 1.0f / determinant;
+  Affine2D result{};
+  result.a = d * inverse;
+  result.b = -b * inverse;
+  result.c = -c * inverse;
+  result.d = a * inverse;
+  result.tx = -(result.a * tx + result.c * ty);
+  result.ty = -(result.b * tx + result.d * ty);
+  result.layer = -layer;
+  return result;
+}
+
+Affine2D Combine(const Affine2D &parent, const Affine2D &local) {
+  Affine2D result{};
+  result.a = parent.a * local.a + parent.c * local.b;
+  result.b = parent.b * local.a + parent.d * local.b;
+  result.c = parent.a * local.c + parent.c * local.d;
+  result.d = parent.b * local.c + parent.d * local.d;
+  auto translation = parent.TransformPoint(glm::vec2(local.tx, local.ty));
+  result.tx = translation.x;
+  result.ty = translation.y;
+  result.layer = parent.layer + local.layer;
+  return result;
+}
+
+glm::mat4 Affine2D::ToMat4() const {
+  auto model = glm::mat4(1.0f);
+  model[0] = glm::vec4(a, b, 0.0f, 0.0f);
+  model[1] = glm::vec4(c, d, 0.0f, 0.0f);
+  model[3] = glm::vec4(tx, ty, layer, 1.0f);
+  return model;
+}
+
+void TransformStreams::Gather(const ComponentSet<Transform> &transforms) {
+  auto &components = transforms.Components();
+  auto count = components.size();
+  position_x.resize(count);
+  position_y.resize(count);
+  layer.resize(count);
+  scale_x.resize(count);
+  scale_y.resize(count);
+  rotation.resize(count);
+  for (std::size_t i = 0; i < count; i++) {
+    auto &transform = components[i];
+    position_x[i] = transform.position.x;
+    position_y[i] = transform.position.y;
+    layer[i] = static_cast<float>(transform.layer);
+    scale_x[i] = transform.scale.x;
+    scale_y[i] = transform.scale.y;
+    rotation[i] = transform.rotation;
+  }
+}
+
+
+const Affine2D *TransformCache::Get(const ComponentSet<Transform> &transforms,
+                                    EntityID entity) const {
+  auto index = transforms.IndexOf(entity);
+  if (index == ComponentSet<Transform>::NULL_INDEX || index >= models.size()) {
+    return nullptr;
+  }
+  return &models[index];
+}
+
+static void ComputeAffineModel(const TransformStreams &streams, std::size_t i,
+                               Affine2D &out) {
+  auto radians = streams.rotation[i] * DEGREES_TO_RADIANS;
+  auto sin = std::sin(radians), cos = std::cos(radians);
+  out.a = cos * streams.scale_x[i];
+  out.b = sin * streams.scale_x[i];
+  out.c = -sin * streams.scale_y[i];
+  out.d = cos * streams.scale_y[i];
+  out.tx = streams.position_x[i];
+  out.ty = streams.position_y[i];
+  out.layer = streams.layer[i];
+  out.padding = 0.0f;
+}
+
+static void GatherOne(TransformStreams &streams, std::size_t i,
+                      const Transform &transform) {
+  streams.position_x[i] = transform.position.x;
+  streams.position_y[i] = transform.position.y;
+  streams.layer[i] = static_cast<float>(transform.layer);
+  streams.scale_x[i] = transform.scale.x;
+  streams.scale_y[i] = transform.scale.y;
+  streams.rotation[i] = transform.rotation;
+}
+
+// Resolves parent links to dense indices and orders every transform
+// breadth-first from the roots. Links that form a cycle are dropped.
+static void LinkHierarchy(const ComponentSet<Transform> &transforms,
+                          const ComponentSet<Hierarchy> &hierarchies,
+                          std::vector<std::uint32_t> &parents,
+                          std::vector<std::uint32_t> &order) {
+  auto count = transforms.Size();
+  parents.assign(count, TransformCache::NO_PARENT);
+  for (auto [entity, hierarchy] : hierarchies) {
+    auto child = transforms.IndexOf(entity);
+    auto parent = transforms.IndexOf(hierarchy.parent);
+    if (child != TransformCache::NO_PARENT &&
+        parent != TransformCache::NO_PARENT && child != parent) {
+      parents[child] = parent;
+    }
+  }
+  // Children of i are children[offsets[i]] .. children[offsets[i + 1] - 1].
+  std::vector<std::uint32_t> offsets(count + 1, 0);
+  for (std::size_t i = 0; i < count; i++) {
+    if (parents[i] != TransformCache::NO_PARENT) {
+      offsets[parents[i] + 1]++;
+    }
+  }
+  for (std::size_t i = 0; i < count; i++) {
+    offsets[i + 1] += offsets[i];
+  }
+  std::vector<std::uint32_t> children(offsets[count]);
+  std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+  for (std::size_t i = 0; i < count; i++) {
+    if (parents[i] != TransformCache::NO_PARENT) {
+      children[cursor[parents[i]]++] = static_cast<std::uint32_t>(i);
+    }
+  }
+
+  order.clear();
+  order.reserve(count);
+  std::vector<std::uint8_t> visited(count, 0);
+  std::size_t head = 0;
+  auto expand = [&]() {
+    for (; head < order.size(); head++) {
+      auto i = order[head];
+      for (auto c = offsets[i]; c < offsets[i + 1]; c++) {
+        visited[children[c]] = 1;
+        order.push_back(children[c]);
+      }
+    }
+  };
+  for (std::size_t i = 0; i < count; i++) {
+    if (parents[i] == TransformCache::NO_PARENT) {
+      visited[i] = 1;
+      order.push_back(static_cast<std::uint32_t>(i));
+    }
+  }
+  expand();
+  for (std::size_t i = 0; i < count && order.size() < count; i++) {
+    if (!visited[i]) {
+      parents[i] = TransformCache::NO_PARENT;
+      visited[i] = 1;
+      order.push_back(static_cast<std::uint32_t>(i));
+      expand();
+    }
+  }
+}
+
+void TransformCache::Update(const ComponentSet<Transform> &transforms,
+                            const ComponentSet<Hierarchy> &hierarchies,
+                            std::uint32_t since, std::uint32_t tick) {
+  auto count = transforms.Size();
+  auto rebuild = since == 0 || source != &transforms ||
+                 transforms.StructureVersion() > since ||
+                 models.size() != count;
+  auto relink = rebuild || hierarchies.StructureVersion() > since ||
+                std::any_of(hierarchies.Versions().begin(),
+                            hierarchies.Versions().end(),
+                            [since](std::uint32_t v) { return v > since; });
+  source = &transforms;
+  auto &transform_versions = transforms.Versions();
+  auto &components = transforms.Components();
+
+  if (hierarchies.Empty()) {
+    locals.clear();
+    parents.clear();
+    order.clear();
+    if (relink) {
+      streams.Gather(transforms);
+      models.resize(count);
+      ion::render::ComputeAffineModels(streams, models.data());
+      versions.assign(count, tick);
+      return;
+    }
+    for (std::size_t i = 0; i < count; i++) {
+      if (transform_versions[i] > since) {
+        GatherOne(streams, i, components[i]);
+        ComputeAffineModel(streams, i, models[i]);
+        versions[i] = tick;
+      }
+    }
+    return;
+  }
+
+  dirty.assign(count, relink ? 1 : 0);
+  if (rebuild || locals.size() != count) {
+    streams.Gather(transforms);
+    locals.resize(count);
+    ion::render::ComputeAffineModels(streams, locals.data());
+    std::fill(dirty.begin(), dirty.end(), 1);
+  } else {
+    for (std::size_t i = 0; i < count; i++) {
+      if (transform_versions[i] > since) {
+        GatherOne(streams, i, components[i]);
+        ComputeAffineModel(streams, i, locals[i]);
+        dirty[i] = 1;
+      }
+    }
+  }
+  if (relink) {
+    LinkHierarchy(transforms, hierarchies, parents, order);
+  }
+  models.resize(count);
+  versions.resize(count, tick);
+  // Breadth-first, so a parent's flag and model are final before its
+  // children are visited.
+  for (auto i : order) {
+    auto parent = parents[i];
+    if (parent != NO_PARENT && dirty[parent]) {
+      dirty[i] = 1;
+    }
+    if (!dirty[i]) {
+      continue;
+    }
+    models[i] =
+        parent == NO_PARENT ? locals[i] : Combine(models[parent], locals[i]);
+    versions[i] = tick;
+  }
+}
+
+#ifdef ION_TRANSFORM_SSE2
+// Cephes-style sincos: reduce to [-pi/4, pi/4] by octant, evaluate both
+// minimax polynomials and select per lane.
+static void SinCos(__m128 x, __m128 &out_sin, __m128 &out_cos) {
+  const auto sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+  auto sign_sin = _mm_and_ps(x, sign_mask);
+  x = _mm_andnot_ps(sign_mask, x);
+
+  auto octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+  octant = _mm_add_epi32(octant, _mm_set1_epi32(1));
+  octant = _mm_and_si128(octant, _mm_set1_epi32(~1));
+  auto y = _mm_cvtepi32_ps(octant);
+
+  auto swap_sign_sin = _mm_castsi128_ps(
+      _mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29));
+  auto poly_mask = _mm_castsi128_ps(_mm_cmpeq_epi32(
+      _mm_and_si128(octant, _mm_set1_epi32(2)), _mm_setzero_si128()));
+  auto sign_cos = _mm_castsi128_ps(_mm_slli_epi32(
+      _mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)),
+                       _mm_set1_epi32(4)),
+      29));
+  sign_sin = _mm_xor_ps(sign_sin, swap_sign_sin);
+
+  x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+  x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+  x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+  auto z = _mm_mul_ps(x, x);
+
+  auto poly_cos = _mm_set1_ps(2.443315711809948e-5f);
+  poly_cos = _mm_add_ps(_mm_mul_ps(poly_cos, z),
+                        _mm_set1_ps(-1.388731625493765e-3f));
+  poly_cos = _mm_add_ps(_mm_mul_ps(poly_cos, z),
+                        _mm_set1_ps(4.166664568298827e-2f));
+  poly_cos = _mm_mul_ps(_mm_mul_ps(poly_cos, z), z);
+  poly_cos = _mm_sub_ps(poly_cos, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+  poly_cos = _mm_add_ps(poly_cos, _mm_set1_ps(1.0f));
+
+  auto poly_sin = _mm_set1_ps(-1.9515295891e-4f);
+  poly_sin =
+      _mm_add_ps(_mm_mul_ps(poly_sin, z), _mm_set1_ps(8.3321608736e-3f));
+  poly_sin =
+      _mm_add_ps(_mm_mul_ps(poly_sin, z), _mm_set1_ps(-1.6666654611e-1f));
+  poly_sin = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(poly_sin, z), x), x);
+
+  auto sin = _mm_or_ps(_mm_and_ps(poly_mask, poly_sin),
+                       _mm_andnot_ps(poly_mask, poly_cos));
+  auto cos = _mm_or_ps(_mm_and_ps(poly_mask, poly_cos),
+                       _mm_andnot_ps(poly_mask, poly_sin));
+  out_sin = _mm_xor_ps(sin, sign_sin);
+  out_cos = _mm_xor_ps(cos, sign_cos);
+}
+#endif
+
+void ion::render::ComputeAffineModels(const TransformStreams &streams,
+                                      Affine2D *out) {
+  std::size_t i = 0;
+  auto count = streams.Size();
+#ifdef ION_TRANSFORM_SSE2
+  static_assert(sizeof(Affine2D) == 8 * sizeof(float));
+  auto *dst = reinterpret_cast<float *>(out);
+  for (; i + 4 <= count; i += 4) {
+    auto radians = _mm_mul_ps(_mm_loadu_ps(&streams.rotation[i]),
+                              _mm_set1_ps(DEGREES_TO_RADIANS));
+    __m128 sin, cos;
+    SinCos(radians, sin, cos);
+    auto scale_x = _mm_loadu_ps(&streams.scale_x[i]);
+    auto scale_y = _mm_loadu_ps(&streams.scale_y[i]);
+    auto a = _mm_mul_ps(cos, scale_x);
+    auto b = _mm_mul_ps(sin, scale_x);
+    auto c = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(sin, scale_y));
+    auto d = _mm_mul_ps(cos, scale_y);
+    auto tx = _mm_loadu_ps(&streams.position_x[i]);
+    auto ty = _mm_loadu_ps(&streams.position_y[i]);
+    auto layer = _mm_loadu_ps(&streams.layer[i]);
+    auto padding = _mm_setzero_ps();
+    // Streams -> four Affine2D records.
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    _MM_TRANSPOSE4_PS(tx, ty, layer, padding);
+    _mm_storeu_ps(dst + (i + 0) * 8, a);
+    _mm_storeu_ps(dst + (i + 0) * 8 + 4, tx);
+    _mm_storeu_ps(dst + (i + 1) * 8, b);
+    _mm_storeu_ps(dst + (i + 1) * 8 + 4, ty);
+    _mm_storeu_ps(dst + (i + 2) * 8, c);
+    _mm_storeu_ps(dst + (i + 2) * 8 + 4, layer);
+    _mm_storeu_ps(dst + (i + 3) * 8, d);
+    _mm_storeu_ps(dst + (i + 3) * 8 + 4, padding);
+  }
+#endif
+  for (; i < count; i++) {
+    ComputeAffineModel(streams, i, out[i]);
+  }
+}
+
+static bool ModelOverlaps(const Affine2D &model, glm::vec2 min, glm::vec2 max) {
+  auto extent_x = (std::abs(model.a) + std::abs(model.c)) * 0.5f;
+  auto extent_y = (std::abs(model.b) + std::abs(model.d)) * 0.5f;
+  return model.tx - extent_x <= max.x && model.tx + extent_x >= min.x &&
+         model.ty - extent_y <= max.y && model.ty + extent_y >= min.y;
+}
+
+void ion::render::CullModels(const Affine2D *models, std::size_t count,
+                             glm::vec2 min, glm::vec2 max,
+                             std::uint8_t *visible) {
+  std::size_t i = 0;
+#ifdef ION_TRANSFORM_SSE2
+  auto *src = reinterpret_cast<const float *>(models);
+  const auto sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+  const auto half = _mm_set1_ps(0.5f);
+  const auto min_x = _mm_set1_ps(min.x), min_y = _mm_set1_ps(min.y);
+  const auto max_x = _mm_set1_ps(max.x), max_y = _mm_set1_ps(max.y);
+  for (; i + 4 <= count; i += 4) {
+    // Four Affine2D records -> streams.
+    auto a = _mm_loadu_ps(src + (i + 0) * 8);
+    auto b = _mm_loadu_ps(src + (i + 1) * 8);
+    auto c = _mm_loadu_ps(src + (i + 2) * 8);
+    auto d = _mm_loadu_ps(src + (i + 3) * 8);
+    auto tx = _mm_loadu_ps(src + (i + 0) * 8 + 4);
+    auto ty = _mm_loadu_ps(src + (i + 1) * 8 + 4);
+    auto layer = _mm_loadu_ps(src + (i + 2) * 8 + 4);
+    auto padding = _mm_loadu_ps(src + (i + 3) * 8 + 4);
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    _MM_TRANSPOSE4_PS(tx, ty, layer, padding);
+    auto extent_x = _mm_mul_ps(
+        _mm_add_ps(_mm_andnot_ps(sign_mask, a), _mm_andnot_ps(sign_mask, c)),
+        half);
+    auto extent_y = _mm_mul_ps(
+        _mm_add_ps(_mm_andnot_ps(sign_mask, b), _mm_andnot_ps(sign_mask, d)),
+        half);
+    auto inside =
+        _mm_and_ps(_mm_and_ps(_mm_cmple_ps(_mm_sub_ps(tx, extent_x), max_x),
+                              _mm_cmpge_ps(_mm_add_ps(tx, extent_x), min_x)),
+                   _mm_and_ps(_mm_cmple_ps(_mm_sub_ps(ty, extent_y), max_y),
+                              _mm_cmpge_ps(_mm_add_ps(ty, extent_y), min_y)));
+    auto mask = _mm_movemask_ps(inside);
+    visible[i + 0] = mask & 1;
+    visible[i + 1] = (mask >> 1) & 1;
+    visible[i + 2] = (mask >> 2) & 1;
+    visible[i + 3] = (mask >> 3) & 1;
+  }
+#endif
+  for (; i < count; i++) {
+    visible[i] = ModelOverlaps(models[i], min, max) ? 1 : 0;
+  }
+}
@@ -1,55 +1,253 @@
 #include "ion/world.h"
+#include "ion/physics.h"
+#include "ion/texture_atlas.h"
+#include <stdexcept>
+#include <unordered_map>
 
 template <>
-std::map<EntityID, std::shared_ptr<Transform>> &
-World::GetComponentSet<Transform>() {
+ComponentSet<Transform> &World::GetComponentSet<Transform>() {
   return transforms;
 }
 
 template <>
-std::map<EntityID, std::shared_ptr<Renderable>> &
-World::GetComponentSet<Renderable>() {
+ComponentSet<Renderable> &World::GetComponentSet<Renderable>() {
   return renderables;
 }
 
 template <>
-std::map<EntityID, std::shared_ptr<PhysicsBody>> &
-World::GetComponentSet<PhysicsBody>() {
+ComponentSet<PhysicsBody> &World::GetComponentSet<PhysicsBody>() {
   return physics_bodies;
 }
 
 template <>
-std::map<EntityID, std::shared_ptr<Camera>> &World::GetComponentSet<Camera>() {
+ComponentSet<Camera> &World::GetComponentSet<Camera>() {
   return cameras;
 }
 
 template <>
-std::map<EntityID, std::shared_ptr<Light>> &World::GetComponentSet<Light>() {
+ComponentSet<Light> &World::GetComponentSet<Light>() {
   return lights;
 }
 
 template <>
-std::map<EntityID, std::shared_ptr<Script>> &World::GetComponentSet<Script>() {
+ComponentSet<Script> &World::GetComponentSet<Script>() {
   return scripts;
 }
 
 template <>
-std::map<EntityID, std::shared_ptr<void *>> &World::GetComponentSet<void *>() {
-  return custom_components;
+ComponentSet<Hierarchy> &World::GetComponentSet<Hierarchy>() {
+  return hierarchies;
 }
 
+World::~World() { ion::res::ReleaseTextureAtlas(this); }
+
 std::map<EntityID, std::string> &World::GetMarkers() { return markers; }
+std::map<std::string, Prefab> &World::GetPrefabs() { return prefabs; }
+
+void World::SetParent(EntityID child, EntityID parent) {
+  if (parent == NULL_ENTITY) {
+    hierarchies.Remove(child);
+    return;
+  }
+  if (!IsValid(child) || !IsValid(parent)) {
+    return;
+  }
+  // Reject links that would make child its own ancestor. The walk is bounded
+  // in case a loaded file already holds a cycle.
+  auto ancestor = parent;
+  for (std::size_t depth = 0;
+       ancestor != NULL_ENTITY && depth <= hierarchies.Size(); depth++) {
+    if (ancestor == child) {
+      return;
+    }
+    ancestor = GetParent(ancestor);
+  }
+  hierarchies.Emplace(child)->parent = parent;
+  hierarchies.MarkChanged(child);
+}
+
+EntityID World::GetParent(EntityID entity) {
+  auto hierarchy = hierarchies.Get(entity);
+  return hierarchy ? hierarchy->parent : NULL_ENTITY;
+}
+
+const TransformCache &World::GetWorldTransforms() {
+  auto since = transform_cache.synced_tick;
+  // Reads with nothing changed since the last sync leave the tick alone.
+  if (since != 0 && transform_cache.source == &transforms &&
+      transforms.LastChange() <= since && hierarchies.LastChange() <= since) {
+    return transform_cache;
+  }
+  transform_cache.Update(transforms, hierarchies, since, tick);
+  transform_cache.synced_tick = AdvanceTick();
+  return transform_cache;
+}
+
+SpatialIndex &World::GetSpatialIndex() {
+  auto &world_transforms = GetWorldTransforms();
+  // Models are stamped with the tick the cache synced to, so the index is
+  // current once it has caught up with that tick.
+  if (spatial_index.synced_tick != world_transforms.synced_tick) {
+    spatial_index.Sync(transforms, world_transforms,
+                       spatial_index.synced_tick);
+    spatial_index.synced_tick = world_transforms.synced_tick;
+  }
+  return spatial_index;
+}
+
+std::uint32_t World::AdvanceTick() {
+  auto closed = tick++;
+  transforms.SetTick(tick);
+  renderables.SetTick(tick);
+  physics_bodies.SetTick(tick);
+  cameras.SetTick(tick);
+  lights.SetTick(tick);
+  scripts.SetTick(tick);
+  hierarchies.SetTick(tick);
+  for (auto &pool : custom_pools) {
+    if (pool) {
+      pool->SetTick(tick);
+    }
+  }
+  return closed;
+}
 
 EntityID World::CreateEntity() {
-  auto id = next_id++;
+  auto id = NULL_ENTITY;
+  while (!free_indices.empty() && id == NULL_ENTITY) {
+    auto index = free_indices.back();
+    free_indices.pop_back();
+    if (GetEntityIndex(slots[index]) == FREE_SLOT_INDEX) {
+      id = MakeEntityID(index, GetEntityGeneration(slots[index]));
+    }
+  }
+  if (id == NULL_ENTITY) {
+    if (slots.size() >= FREE_SLOT_INDEX) {
+      throw std::runtime_error("Entity limit reached");
+    }
+    id = MakeEntityID(static_cast<std::uint32_t>(slots.size()), 0);
+    slots.push_back(id);
+  }
+  slots[GetEntityIndex(id)] = id;
+  entity_count++;
   NewComponent<Transform>(id);
   return id;
 }
 
+EntityRange World::AllocateEntities(std::uint32_t count) {
+  if (slots.size() + count >= FREE_SLOT_INDEX) {
+    throw std::runtime_error("Entity limit reached");
+  }
+  auto first = static_cast<std::uint32_t>(slots.size());
+  slots.resize(slots.size() + count);
+  for (std::uint32_t i = 0; i < count; i++) {
+    slots[first + i] = MakeEntityID(first + i, 0);
+  }
+  entity_count += count;
+  return EntityRange{MakeEntityID(first, 0), count};
+}
+
+EntityRange World::CreateEntities(std::uint32_t count) {
+  auto range = AllocateEntities(count);
+  transforms.EmplaceRange(range.first, count, Transform{});
+  return range;
+}
+
+EntityRange World::Instantiate(const Prefab &prefab, std::uint32_t count) {
+  auto range = AllocateEntities(count);
+  transforms.EmplaceRange(range.first, count, prefab.transform);
+  if (prefab.renderable) {
+    renderables.EmplaceRange(range.first, count, *prefab.renderable);
+  }
+  if (prefab.light) {
+    lights.EmplaceRange(range.first, count, *prefab.light);
+  }
+  if (prefab.camera) {
+    cameras.EmplaceRange(range.first, count, *prefab.camera);
+  }
+  if (prefab.script) {
+    scripts.EmplaceRange(range.first, count, *prefab.script);
+  }
+  if (prefab.physics_body) {
+    physics_bodies.EmplaceRange(range.first, count, *prefab.physics_body);
+    auto body = physics_bodies.Components().end() - count;
+    for (std::uint32_t i = 0; i < count; i++, body++) {
+      body->body_id = ion::physics::CreateBody(prefab.transform);
+    }
+  }
+  return range;
+}
+
+void World::RestoreEntity(EntityID entity) {
+  auto index = GetEntityIndex(entity);
+  if (index == 0 || index == FREE_SLOT_INDEX || IsValid(entity)) {
+    return;
+  }
+  while (slots.size() <= index) {
+    free_indices.push_back(static_cast<std::uint32_t>(slots.size()));
+    slots.push_back(MakeEntityID(FREE_SLOT_INDEX, 0));
+  }
+  if (GetEntityIndex(slots[index]) == FREE_SLOT_INDEX) {
+    entity_count++;
+  }
+  slots[index] = entity;
+}
+
 void World::DestroyEntity(EntityID entity) {
-  transforms.erase(entity);
-  renderables.erase(entity);
-  physics_bodies.erase(entity);
-  cameras.erase(entity);
-  lights.erase(entity);
+  if (!IsValid(entity)) {
+    return;
+  }
+  // Collect the subtree from a children index built in one pass, instead of
+  // scanning every hierarchy for each destroyed entity.
+  std::vector<EntityID> subtree{entity};
+  if (!hierarchies.Empty()) {
+    std::unordered_map<EntityID, std::vector<EntityID>> children;
+    for (auto [child, hierarchy] : hierarchies) {
+      children[hierarchy.parent].push_back(child);
+    }
+    for (std::size_t i = 0; i < subtree.size(); i++) {
+      // Each entry is expanded once, so a cycle cannot loop forever.
+      if (auto node = children.extract(subtree[i])) {
+        subtree.insert(subtree.end(), node.mapped().begin(),
+                       node.mapped().end());
+      }
+    }
+  }
+  for (auto destroyed : subtree) {
+    ReleaseEntity(destroyed);
+  }
+}
+
+void World::ReleaseEntity(EntityID entity) {
+  if (!IsValid(entity)) {
+    return;
+  }
+  if (auto body = physics_bodies.Get(entity);
+      body && b2Body_IsValid(body->body_id)) {
+    b2DestroyBody(body->body_id);
+  }
+  transforms.Remove(entity);
+  renderables.Remove(entity);
+  physics_bodies.Remove(entity);
+  cameras.Remove(entity);
+  lights.Remove(entity);
+  scripts.Remove(entity);
+  hierarchies.Remove(entity);
+  for (auto &pool : custom_pools) {
+    if (pool) {
+      pool->Remove(entity);
+    }
+  }
+  markers.erase(entity);
+  auto index = GetEntityIndex(entity);
+  auto generation = GetEntityGeneration(entity) + 1;
+  // A slot whose generation would wrap to 0 is retired instead of reissued,
+  // so the oldest handles to it can never become valid again.
+  if (generation <= ENTITY_GENERATION_MASK) {
+    slots[index] = MakeEntityID(FREE_SLOT_INDEX, generation);
+    free_indices.push_back(index);
+  } else {
+    slots[index] = MakeEntityID(FREE_SLOT_INDEX, ENTITY_GENERATION_MASK);
+  }
+  entity_count--;
 }
@@ -3,10 +3,14 @@
 #include "ion/development/gui.h"
 #include "ion/development/id.h"
 #include "ion/development/package.h"
+#include "ion/gl_state.h"
 #include "ion/physics.h"
 #include "ion/shader.h"
+#include "ion/stream_buffer.h"
 #include "ion/systems.h"
 #include "ion/texture.h"
+#include "ion/texture_atlas.h"
+#include "ion/texture_loader.h"
 #include "ion/world.h"
 #include <format>
 #include <glm/gtc/type_ptr.hpp>
@@ -48,6 +52,13 @@ static std::vector<std::string> SplitString(const std::string &str,
   return tokens;
 }
 
+// Preview of the texture's own image, also when it lives in an atlas page.
+static void TextureImage(const Texture &texture) {
+  auto uv = texture.uv_rect;
+  ImGui::Image(texture.texture, ImVec2(100, 100), ImVec2(uv.x, uv.y),
+               ImVec2(uv.x + uv.z, uv.y + uv.w));
+}
+
 static std::map<int, std::filesystem::path> GetWorldPaths() {
   std::map<int, std::filesystem::path> world_paths;
   for (const auto &[id, world] : ion::res::GetWorlds()) {
@@ -135,7 +146,7 @@ static void WorldInspector(std::shared_ptr<World> &world, Defaults &defaults) {
 
     if (ImGui::BeginPopupModal("Add Marker")) {
       ImGui::SeparatorText("Select Entity");
-      for (auto &[id, transform] : world->GetComponentSet<Transform>()) {
+      for (auto [id, transform] : world->GetComponentSet<Transform>()) {
         if (ImGui::Selectable(std::format("Entity {}", id).c_str(),
                               selected_entity == id,
                               ImGuiSelectableFlags_DontClosePopups)) {
@@ -159,7 +170,7 @@ static void WorldInspector(std::shared_ptr<World> &world, Defaults &defaults) {
 
     if (ImGui::BeginPopupModal("Add Component")) {
       ImGui::SeparatorText("Select Entity");
-      for (auto &[id, transform] : world->GetComponentSet<Transform>()) {
+      for (auto [id, transform] : world->GetComponentSet<Transform>()) {
         if (ImGui::Selectable(std::format("Entity {}", id).c_str(),
                               selected_entity == id,
                               ImGuiSelectableFlags_DontClosePopups)) {
@@ -171,7 +182,7 @@ static void WorldInspector(std::shared_ptr<World> &world, Defaults &defaults) {
       if (ImGui::Selectable("Physics Body") && selected_entity != -1) {
         world->NewComponent<PhysicsBody>(selected_entity)->body_id =
             ion::physics::CreateBody(
-                world->GetComponent<Transform>(selected_entity));
+                *world->GetComponent<Transform>(selected_entity));
         ImGui::CloseCurrentPopup();
       }
       if (ImGui::Selectable("Renderable") && selected_entity != -1) {
@@ -188,11 +199,11 @@ static void WorldInspector(std::shared_ptr<World> &world, Defaults &defaults) {
         ImGui::CloseCurrentPopup();
       }
       if (ImGui::Selectable("Script") && selected_entity != -1) {
-        auto script_component = world->NewComponent<Script>(selected_entity);
+        world->NewComponent<Script>(selected_entity);
         ImGui::CloseCurrentPopup();
       }
       if (ImGui::Selectable("Camera") && selected_entity != -1) {
-        auto script_component = world->NewComponent<Camera>(selected_entity);
+        world->NewComponent<Camera>(selected_entity);
         ImGui::CloseCurrentPopup();
       }
       if (ImGui::Button("Cancel")) {
@@ -205,7 +216,7 @@ static void WorldInspector(std::shared_ptr<World> &world, Defaults &defaults) {
   ImGui::SeparatorText("Entities");
 
   auto &transforms = world->GetComponentSet<Transform>();
-  for (auto &[id, transform] : transforms) {
+  for (auto [id, transform] : transforms) {
     ImGui::PushID(id);
     if (ImGui::CollapsingHeader(std::format("Entity {}", id).c_str(),
                                 ImGuiTreeNodeFlags_DefaultOpen)) {
@@ -218,11 +229,16 @@ static void WorldInspector(std::shared_ptr<World> &world, Defaults &defaults) {
       }
 
       if (ImGui::TreeNodeEx("Transform", ImGuiTreeNodeFlags_DefaultOpen)) {
-        ImGui::DragFloat2("Position", glm::value_ptr(transform->position),
-                          0.1f);
-        ImGui::DragInt("Layer", &transform->layer, 1.0F, 0, 100);
-        ImGui::DragFloat2("Scale", glm::value_ptr(transform->scale), 0.1f);
-        ImGui::DragFloat("Rotation", &transform->rotation, 0.1f);
+        bool changed = false;
+        changed |= ImGui::DragFloat2(
+            "Position", glm::value_ptr(transform.position), 0.1f);
+        changed |= ImGui::DragInt("Layer", &transform.layer, 1.0F, 0, 100);
+        changed |=
+            ImGui::DragFloat2("Scale", glm::value_ptr(transform.scale), 0.1f);
+        changed |= ImGui::DragFloat("Rotation", &transform.rotation, 0.1f);
+        if (changed) {
+          transforms.MarkChanged(id);
+        }
         ImGui::TreePop();
       }
       if (world->ContainsComponent<Renderable>(id)) {
@@ -232,7 +248,7 @@ static void WorldInspector(std::shared_ptr<World> &world, Defaults &defaults) {
           if (!renderable->color) {
             ImGui::Text("None");
           } else {
-            ImGui::Image(renderable->color->texture, ImVec2(100, 100));
+            TextureImage(*renderable->color);
           }
           if (ImGui::BeginDragDropTarget()) {
             if (const ImGuiPayload *payload =
@@ -248,7 +264,7 @@ static void WorldInspector(std::shared_ptr<World> &world, Defaults &defaults) {
           if (!renderable->normal) {
             ImGui::Text("None");
           } else {
-            ImGui::Image(renderable->normal->texture, ImVec2(100, 100));
+            TextureImage(*renderable->normal);
           }
           if (ImGui::BeginDragDropTarget()) {
             if (const ImGuiPayload *payload =
@@ -288,7 +304,10 @@ static void WorldInspector(std::shared_ptr<World> &world, Defaults &defaults) {
       if (world->ContainsComponent<PhysicsBody>(id)) {
         if (ImGui::TreeNode("Physics Body")) {
           auto physics_body = world->GetComponent<PhysicsBody>(id);
-          ImGui::Checkbox("Enabled", &physics_body->enabled);
+          if (ImGui::Checkbox("Enabled", &physics_body->enabled)) {
+            // Push the current transform to the body on the next update.
+            world->MarkChanged<Transform>(id);
+          }
           if (ion::physics::BodyIsValid(physics_body->body_id)) {
             ImGui::TextColored({0.0, 1.0, 0.0, 1.0}, "Body ID is Valid.");
           } else {
@@ -297,9 +316,17 @@ static void WorldInspector(std::shared_ptr<World> &world, Defaults &defaults) {
           ImGui::TreePop();
         }
       }
+      if (world->ContainsComponent<Hierarchy>(id)) {
+        if (ImGui::TreeNode("Hierarchy")) {
+          ImGui::Text("Parent: Entity %u", world->GetParent(id));
+          if (ImGui::Button("Detach")) {
+            world->SetParent(id, NULL_ENTITY);
+          }
+          ImGui::TreePop();
+        }
+      }
       if (world->ContainsComponent<Camera>(id)) {
         if (ImGui::TreeNode("Camera")) {
-          auto camera = world->GetComponent<Camera>(id);
           ImGui::Text("Camera Component");
           ImGui::TreePop();
         }
@@ -378,7 +405,7 @@ static void AssetInspector(std::shared_ptr<World> &world) {
   }
   for (const auto &[id, texture] : ion::res::GetTextures()) {
     ImGui::PushID(id.c_str());
-    ImGui::Image(ion::res::GetTextures().at(id)->texture, ImVec2(100, 100));
+    TextureImage(*texture);
     if (ImGui::IsItemHovered()) {
       ImGui::BeginTooltip();
       ImGui::Text("Path: %s", texture->GetPath().string().c_str());
@@ -447,7 +474,7 @@ static void AssetInspector(std::shared_ptr<World> &world) {
   ImGui::End();
 }
 
-static void RenderSettingInspector() {
+static void RenderSettingInspector(BasePipeline &pipeline) {
   ImGui::Begin("Render");
   auto render_scale = ion::render::GetRenderScale();
   if (ImGui::DragInt("Render Scale", &render_scale, 1, 1, 16)) {
@@ -457,6 +484,57 @@ static void RenderSettingInspector() {
   if (ImGui::ColorEdit3("Clear Color", glm::value_ptr(clear_color), 0.01f)) {
     ion::render::SetClearColor(clear_color);
   }
+  auto spatial_culling = ion::render::GetSpatialCulling();
+  if (ImGui::Checkbox("Spatial Culling", &spatial_culling)) {
+    ion::render::SetSpatialCulling(spatial_culling);
+  }
+  auto dynamic_resolution = ion::render::GetDynamicResolution();
+  auto dynamic_changed = ImGui::Checkbox("Dynamic Resolution",
+                                         &dynamic_resolution.enabled);
+  dynamic_changed |= ImGui::DragFloatRange2(
+      "Resolution Scale Range", &dynamic_resolution.min_scale,
+      &dynamic_resolution.max_scale, 0.01f, 0.1f, 1.0f);
+  dynamic_changed |= ImGui::DragFloat("GPU Budget (ms)",
+                                      &dynamic_resolution.target_ms, 0.1f,
+                                      1.0f, 100.0f);
+  if (dynamic_changed) {
+    ion::render::SetDynamicResolution(dynamic_resolution);
+  }
+  auto frame_timing = ion::render::GetFrameTiming();
+  ImGui::Text("Resolution Scale: %.2f", ion::render::GetResolutionScale());
+  ImGui::Text("Frame Time: %.2f ms", frame_timing.frame_ms);
+  ImGui::Text("GPU Time: %.2f ms", frame_timing.gpu_ms);
+  if (auto packet = pipeline.snapshots.Latest()) {
+    ImGui::Text("Visible Sprites: %u", packet->culling.visible);
+    ImGui::Text("Culled Sprites: %u", packet->culling.culled);
+    ImGui::Text("Incomplete Sprites: %u", packet->culling.incomplete);
+  }
+  auto draw_stats = ion::render::GetDrawStats();
+  ImGui::Text("Sprite Draw Calls: %u", draw_stats.draw_calls);
+  ImGui::Text("Sprite Instances: %u", draw_stats.instances);
+  ImGui::Text("Lights: %u", draw_stats.lights);
+  ImGui::Text("Light Tile Entries: %u", draw_stats.light_tile_entries);
+  auto gl_stats = ion::render::gl::GetStats();
+  ImGui::Text("GL State Changes: %u", gl_stats.issued);
+  ImGui::Text("GL State Changes Skipped: %u", gl_stats.skipped);
+  auto graph_stats = pipeline.graph.GetStats();
+  ImGui::Text("Render Passes: %u (%u culled)", graph_stats.passes,
+    graph_stats.culled_passes);
+  ImGui::Text("Transient Targets: %u in %u framebuffers",
+    graph_stats.transients, graph_stats.targets);
+  auto stream_stats = ion::render::GetStreamBuffer().GetStats();
+  ImGui::Text("Stream Buffer: %zu / %zu KiB (%s)", stream_stats.used / 1024,
+              stream_stats.section_size / 1024,
+              stream_stats.persistent ? "persistent" : "mapped ranges");
+  ImGui::Text("Stream Buffer Waits: %u", stream_stats.waits);
+  ImGui::Text("Pending Texture Loads: %zu", ion::res::GetPendingTextureLoads());
+  ImGui::SeparatorText("GPU Passes");
+  for (const auto &pass : ion::render::GetPassTimings()) {
+    ImGui::Text("%s: %.3f ms", pass.name.c_str(), pass.gpu_ms);
+  }
+  if (ImGui::Button("Save GPU Timings")) {
+    ion::render::WriteTimingsCSV("gpu_timings.csv");
+  }
   ImGui::End();
 }
 
@@ -525,20 +603,32 @@ void FramebufferInspector(PipelineSettings& settings) {
     BLOOM_STRENGTH_MIN, BLOOM_STRENGTH_MAX);
   for (auto& [buffer, name] : ion::render::GetFramebuffers()) {
     ImGui::PushID(buffer->framebuffer);
-    ImGui::Image(buffer->colorbuffer, FRAMEBUFFER_PREVIEW_SIZE,
-      FRAMEBUFFER_UV_0, FRAMEBUFFER_UV_1);
-    ImGui::SameLine();
+    for (auto colorbuffer : buffer->colorbuffers) {
+      ImGui::Image(colorbuffer, FRAMEBUFFER_PREVIEW_SIZE,
+        FRAMEBUFFER_UV_0, FRAMEBUFFER_UV_1);
+      ImGui::SameLine();
+    }
     ImGui::TextUnformatted(name.c_str());
     ImGui::PopID();
   }
+  for (auto &page : ion::res::GetAtlasPages()) {
+    ImGui::Image(page.color, FRAMEBUFFER_PREVIEW_SIZE);
+    ImGui::SameLine();
+    ImGui::Image(page.normal, FRAMEBUFFER_PREVIEW_SIZE);
+    ImGui::SameLine();
+    ImGui::Text("Atlas %dx%d, %u sprites", page.size.x, page.size.y,
+                page.sprites);
+  }
   ImGui::End();
 }
 
 void ViewportInspector(BasePipeline& pipeline) {
   ImGui::Begin("Viewport", nullptr, ImGuiWindowFlags_NoDecoration);
 	auto window_size = ImGui::GetWindowSize();
-  ImGui::Image(pipeline.output_buffer->colorbuffer, window_size,
-		FRAMEBUFFER_UV_0, FRAMEBUFFER_UV_1);
+  if (pipeline.output_buffer) {
+    ImGui::Image(pipeline.output_buffer->colorbuffer, window_size,
+      FRAMEBUFFER_UV_0, FRAMEBUFFER_UV_1);
+  }
   ImGui::End();
 }
 
@@ -594,7 +684,7 @@ void ion::dev::ui::RenderInspector(std::shared_ptr<World> &world,
     AssetInspector(world);
   }
   if (internal::inspector_state[RENDER_SETTINGS_KEY]) {
-    RenderSettingInspector();
+    RenderSettingInspector(pipeline);
   }
   if (internal::inspector_state[SYSTEM_INSPECTOR_KEY]) {
     SystemInspector();
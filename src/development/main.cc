@@ -10,6 +10,7 @@
 #include "ion/shader.h"
 #include "ion/systems.h"
 #include "ion/texture.h"
+#include "ion/texture_loader.h"
 #include "ion/world.h"
 #include <format>
 #include <glm/gtc/type_ptr.hpp>
@@ -20,6 +21,7 @@
 
 static void Init() {
   ion::render::Init();
+  ion::res::SetAsyncTextureLoading(true);
   ion::gui::Init(ion::render::GetWindow());
   ION_GUI_PREP_CONTEXT();
   ion::physics::Init();
@@ -68,6 +70,7 @@ int main() {
 
     while (!glfwWindowShouldClose(ion::render::GetWindow())) {
       glfwPollEvents();
+      ion::res::UpdateTextureLoads();
       ion::systems::UpdateSystems(world, ion::systems::UpdatePhase::PRE_UPDATE);
       ion::gui::NewFrame();
       ion::dev::ui::RenderInspector(world, defaults, pipeline, pipeline_settings);
@@ -84,6 +87,7 @@ int main() {
     printf("Runtime Error: %s\n", e.what());
   }
 
+  ion::res::StopTextureLoads();
   ion::physics::Quit();
   ion::script::Quit();
   ion::render::Quit();
@@ -5,19 +5,24 @@
 void ion::game::Update(std::shared_ptr<World> &world) {
   for (auto &[entity, marker] : world->GetMarkers()) {
     if (marker == "player") {
-      auto transform = world->GetComponent<Transform>(entity);
       auto window = ion::render::GetWindow();
+      auto delta = glm::vec2(0.0f);
       if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        transform->position.y += 0.1f;
+        delta.y += 0.1f;
       }
       if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        transform->position.y -= 0.1f;
+        delta.y -= 0.1f;
       }
       if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        transform->position.x -= 0.1f;
+        delta.x -= 0.1f;
       }
       if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        transform->position.x += 0.1f;
+        delta.x += 0.1f;
+      }
+      if (delta != glm::vec2(0.0f)) {
+        world->Patch<Transform>(entity, [delta](Transform &transform) {
+          transform.position += delta;
+        });
       }
     }
   }
@@ -10,9 +10,51 @@
 #include "ion/base_pipeline.h"
 #include "ion/systems.h"
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <pugixml.hpp>
 #include <sstream>
+#include <string>
+#include <string_view>
+
+// Command line options. With --headless the runner draws a fixed number of
+// frames offscreen and exits, e.g.
+//   ion-run --headless --frames 300 --size 1280x720 --screenshot out.png
+struct RunOptions {
+  bool headless = false;
+  int frames = 60;
+  glm::ivec2 size = glm::ivec2(800, 600);
+  // Written after the last headless frame when set.
+  std::string screenshot;
+  std::string timings;
+};
+
+static RunOptions ParseOptions(int argc, char **argv) {
+  auto options = RunOptions{};
+  for (int i = 1; i < argc; i++) {
+    auto arg = std::string_view(argv[i]);
+    auto has_value = i + 1 < argc;
+    if (arg == "--headless") {
+      options.headless = true;
+    } else if (arg == "--frames" && has_value) {
+      options.frames = std::max(std::atoi(argv[++i]), 1);
+    } else if (arg == "--size" && has_value) {
+      int width = 0, height = 0;
+      if (std::sscanf(argv[++i], "%dx%d", &width, &height) == 2) {
+        options.size = glm::ivec2(width, height);
+      }
+    } else if (arg == "--screenshot" && has_value) {
+      options.screenshot = argv[++i];
+    } else if (arg == "--timings" && has_value) {
+      options.timings = argv[++i];
+    } else {
+      printf("Unknown option: %s\n", argv[i]);
+    }
+  }
+  return options;
+}
 
 std::map<int, std::filesystem::path> ReadWorldList(std::filesystem::path path) {
 	if (!std::filesystem::exists(path)) {
@@ -37,8 +79,12 @@ std::map<int, std::filesystem::path> ReadWorldList(std::filesystem::path path) {
 	return world_list;
 }
 
-static void Init() {
-  ion::render::Init();
+static void Init(const RunOptions &options) {
+  auto result = options.headless ? ion::render::InitHeadless(options.size)
+                                 : ion::render::Init();
+  if (result != 0) {
+    throw std::runtime_error("Failed to create a GL context");
+  }
   ion::physics::Init();
   ion::script::Init();
 }
@@ -55,7 +101,8 @@ static void RegisterAllSystems() {
        ion::systems::UpdateCondition::WHEN_PLAYING, ion::game::Update});
 }
 
-int main() {
+int main(int argc, char **argv) {
+  auto options = ParseOptions(argc, argv);
   if (!ion::res::CheckApplicationStructure()) {
     printf("Invalid application structure. Exiting.\n");
     return -1;
@@ -69,7 +116,7 @@ int main() {
   }
 
   try {
-    Init();
+    Init(options);
 		RegisterAllSystems();
   } catch (std::exception &e) {
     printf("Init Error: %s\n", e.what());
@@ -80,18 +127,36 @@ int main() {
 	ion::systems::SetState(true);
 
 	auto pipeline_settings = PipelineSettings{};
+  // A surfaceless context has no default framebuffer to present into.
+  pipeline_settings.render_to_output_buffer = options.headless;
   auto pipeline = BasePipeline{};
   auto defaults = Defaults{};
 
-  while (!glfwWindowShouldClose(ion::render::GetWindow())) {
+  int frame = 0;
+  while (options.headless ? frame < options.frames
+                          : !glfwWindowShouldClose(ion::render::GetWindow())) {
     glfwPollEvents();
 		ion::systems::UpdateSystems(world, ion::systems::UpdatePhase::PRE_UPDATE);
 		ion::systems::UpdateSystems(world, ion::systems::UpdatePhase::UPDATE);
 		pipeline.Render(world, pipeline_settings);
+    if (options.headless && frame == options.frames - 1 &&
+        !options.screenshot.empty()) {
+      ion::render::SaveScreenshot(options.screenshot, pipeline.output_buffer);
+    }
     ion::render::Present();
+    frame++;
 		ion::systems::UpdateSystems(world, ion::systems::UpdatePhase::LATE_UPDATE);
   }
 
+  if (options.headless) {
+    auto timing = ion::render::GetFrameTiming();
+    printf("Rendered %d frames. Last frame: %.2f ms, GPU: %.2f ms\n", frame,
+           timing.frame_ms, timing.gpu_ms);
+    if (!options.timings.empty()) {
+      ion::render::WriteTimingsCSV(options.timings);
+    }
+  }
+
   ion::physics::Quit();
   ion::script::Quit();
   ion::render::Quit();